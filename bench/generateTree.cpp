@@ -0,0 +1,322 @@
+// Generates a reproducible directory tree to benchmark findGitRepos against. The same root, shape, seed
+// and size always produce the same tree.
+//
+// Usage: generateTree [--snapshot] <root> <shape> <seed> <size>
+//
+// With --snapshot the tree is only built in memory and root is the file its snapshot is written to, for
+// findGitRepos.loadSnapshot (see MemoryFileSystem.h). Snapshots reach sizes the disk of a dev box does not.
+//
+// Shapes:
+// - wide: a few levels of directories with many children each,
+// - deep: long chains of nested directories,
+// - node_modules: projects with nested node_modules folders, a few of them repositories,
+// - many-small-repos: organizations holding many small repositories,
+// - home: a home directory, mostly application data, with the repositories in a few folders named like
+//   code or projects,
+// - dt-unknown: the wide tree. bench/run.js searches it with entry types hidden, so every entry is looked
+//   up like on file systems that do not report them. As a snapshot, its listings report no entry types.
+//
+// Prints a JSON summary of the generated tree.
+
+#include <cctype>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+  struct SnapshotEntry {
+    explicit SnapshotEntry(char _type):
+      type(_type)
+    {}
+
+    char type;
+    std::string contents;
+    std::map<std::string, std::unique_ptr<SnapshotEntry>> children;
+  };
+
+  struct TreeGenerator {
+    TreeGenerator(std::uint64_t seed, std::uint64_t size, bool inMemory):
+      snapshot(inMemory ? new SnapshotEntry('d') : nullptr),
+      random(seed),
+      maxDirectories(size),
+      limit(size),
+      numDirectories(0),
+      numFiles(0),
+      numRepositories(0)
+    {}
+
+    bool full() const {
+      return numDirectories >= maxDirectories || numDirectories >= limit;
+    }
+
+    std::uint64_t pick(std::uint64_t min, std::uint64_t max) {
+      return std::uniform_int_distribution<std::uint64_t>(min, max)(random);
+    }
+
+    bool chance(double probability) {
+      return std::bernoulli_distribution(probability)(random);
+    }
+
+    // Creates the entries leading to path as directories, like create_directories.
+    SnapshotEntry &snapshotEntry(const fs::path &path, char type) {
+      SnapshotEntry *entry = snapshot.get();
+      for (auto component = path.begin(); component != path.end(); ++component) {
+        if (component->empty() || *component == ".") {
+          continue;
+        }
+
+        auto &child = entry->children[component->string()];
+        if (!child) {
+          child.reset(new SnapshotEntry(std::next(component) == path.end() ? type : 'd'));
+        }
+        entry = child.get();
+      }
+      return *entry;
+    }
+
+    void directory(const fs::path &path) {
+      if (snapshot) {
+        snapshotEntry(path, 'd');
+      } else {
+        fs::create_directories(path);
+      }
+      ++numDirectories;
+    }
+
+    void file(const fs::path &path, const std::string &contents) {
+      if (snapshot) {
+        snapshotEntry(path, 'f').contents = contents;
+      } else {
+        std::ofstream(path) << contents;
+      }
+      ++numFiles;
+    }
+
+    void files(const fs::path &path, std::uint64_t count) {
+      for (std::uint64_t i = 0; i < count; ++i) {
+        file(path / ("file" + std::to_string(i) + ".txt"), std::string());
+      }
+    }
+
+    // One line per entry, depth first. With unknownTypes every type letter is written in upper case, so
+    // the listings of the snapshot report the entries as unknown.
+    static void writeSnapshot(std::ostream &out, const std::string &name, const SnapshotEntry &entry, std::uint64_t depth, bool unknownTypes) {
+      out << depth << '\t' << (unknownTypes ? (char)std::toupper(entry.type) : entry.type) << '\t' << name;
+      if (!entry.contents.empty()) {
+        out << '\t';
+        for (const char character : entry.contents) {
+          if (character == '\n') {
+            out << "\\n";
+          } else if (character == '\r') {
+            out << "\\r";
+          } else if (character == '\t') {
+            out << "\\t";
+          } else if (character == '\\') {
+            out << "\\\\";
+          } else {
+            out << character;
+          }
+        }
+      }
+      out << '\n';
+
+      for (const auto &child : entry.children) {
+        writeSnapshot(out, child.first, *child.second, depth + 1, unknownTypes);
+      }
+    }
+
+    // Just enough of a .git directory to have the entries a search reads past.
+    void repository(const fs::path &path) {
+      directory(path);
+      directory(path / ".git");
+      directory(path / ".git" / "objects");
+      directory(path / ".git" / "refs" / "heads");
+      file(path / ".git" / "HEAD", "ref: refs/heads/main\n");
+      files(path, pick(1, 4));
+      ++numRepositories;
+    }
+
+    void wide(const fs::path &root) {
+      directory(root);
+      const std::uint64_t breadth = 64;
+      for (std::uint64_t i = 0; !full(); ++i) {
+        const fs::path group = root / ("group" + std::to_string(i));
+        directory(group);
+        for (std::uint64_t j = 0; j < breadth && !full(); ++j) {
+          const fs::path child = group / ("dir" + std::to_string(j));
+          if (chance(0.05)) {
+            repository(child);
+            continue;
+          }
+
+          directory(child);
+          files(child, pick(0, 3));
+          for (std::uint64_t k = 0, numLeaves = pick(0, 8); k < numLeaves && !full(); ++k) {
+            directory(child / ("leaf" + std::to_string(k)));
+          }
+        }
+      }
+    }
+
+    void deep(const fs::path &root) {
+      directory(root);
+      for (std::uint64_t i = 0; !full(); ++i) {
+        fs::path current = root / ("chain" + std::to_string(i));
+        directory(current);
+        for (std::uint64_t depth = 0, maxDepth = pick(32, 128); depth < maxDepth && !full(); ++depth) {
+          if (chance(0.02)) {
+            repository(current / "sibling");
+          }
+          current /= "level" + std::to_string(depth);
+          directory(current);
+          files(current, pick(0, 1));
+        }
+        repository(current / "leaf");
+      }
+    }
+
+    void packages(const fs::path &nodeModules, std::uint64_t depth) {
+      directory(nodeModules);
+      for (std::uint64_t i = 0, numPackages = pick(4, 24); i < numPackages && !full(); ++i) {
+        const fs::path package = nodeModules / ("package" + std::to_string(i));
+        directory(package);
+        files(package, pick(2, 6));
+        directory(package / "lib");
+        files(package / "lib", pick(1, 8));
+        if (depth < 3 && chance(0.3)) {
+          packages(package / "node_modules", depth + 1);
+        }
+      }
+    }
+
+    void nodeModules(const fs::path &root) {
+      directory(root);
+      for (std::uint64_t i = 0; !full(); ++i) {
+        const fs::path project = root / ("project" + std::to_string(i));
+        // The node_modules of a repository are never searched, those of other projects are.
+        if (chance(0.2)) {
+          repository(project);
+        } else {
+          directory(project);
+          files(project, pick(1, 4));
+        }
+        // Bounded per project, so a single dependency tree does not use up the whole size.
+        limit = numDirectories + pick(50, 400);
+        packages(project / "node_modules", 0);
+        limit = maxDirectories;
+      }
+    }
+
+    void manySmallRepositories(const fs::path &root) {
+      directory(root);
+      for (std::uint64_t i = 0; !full(); ++i) {
+        const fs::path organization = root / ("organization" + std::to_string(i));
+        directory(organization);
+        for (std::uint64_t j = 0, numRepositories = pick(16, 256); j < numRepositories && !full(); ++j) {
+          repository(organization / ("repository" + std::to_string(j)));
+        }
+      }
+    }
+
+    void applicationData(const fs::path &path, std::uint64_t depth) {
+      directory(path);
+      files(path, pick(0, 6));
+      for (std::uint64_t i = 0, numChildren = depth < 4 ? pick(1, 6) : 0; i < numChildren && !full(); ++i) {
+        applicationData(path / ("data" + std::to_string(i)), depth + 1);
+      }
+    }
+
+    void home(const fs::path &root) {
+      directory(root);
+      const char *const dataFolders[] = { ".cache", ".local/share", ".config", ".npm", "Documents", "Downloads" };
+      const char *const repositoryFolders[] = { "code", "projects", "src" };
+      for (std::uint64_t i = 0; !full(); ++i) {
+        // One folder of repositories for every nine of application data.
+        if (i % 10 != 9) {
+          applicationData(root / dataFolders[i % 6] / ("app" + std::to_string(i)), 0);
+          continue;
+        }
+
+        const fs::path group = root / repositoryFolders[i / 10 % 3] / ("group" + std::to_string(i));
+        directory(group);
+        for (std::uint64_t j = 0, numRepositories = pick(2, 12); j < numRepositories && !full(); ++j) {
+          repository(group / ("repository" + std::to_string(j)));
+        }
+      }
+    }
+
+    // Null when the tree is written to disk.
+    const std::unique_ptr<SnapshotEntry> snapshot;
+    std::mt19937_64 random;
+    const std::uint64_t maxDirectories;
+    std::uint64_t limit;
+    std::uint64_t numDirectories;
+    std::uint64_t numFiles;
+    std::uint64_t numRepositories;
+  };
+}
+
+int main(int argc, char **argv) {
+  const bool inMemory = argc > 1 && std::string(argv[1]) == "--snapshot";
+  if (argc != (inMemory ? 6 : 5)) {
+    std::cerr << "Usage: " << argv[0] << " [--snapshot] <root> <wide|deep|node_modules|many-small-repos|home|dt-unknown> <seed> <size>" << std::endl;
+    return 1;
+  }
+
+  char **arguments = argv + (inMemory ? 2 : 1);
+  const fs::path output = arguments[0];
+  // A snapshot holds the tree below its root, whatever the file is called.
+  const fs::path root = inMemory ? fs::path() : output;
+  const std::string shape = arguments[1];
+  TreeGenerator generator(std::strtoull(arguments[2], nullptr, 10), std::strtoull(arguments[3], nullptr, 10), inMemory);
+
+  std::error_code error;
+  if (!inMemory) {
+    fs::remove_all(root, error);
+  }
+
+  try {
+    if (shape == "wide" || shape == "dt-unknown") {
+      generator.wide(root);
+    } else if (shape == "deep") {
+      generator.deep(root);
+    } else if (shape == "node_modules") {
+      generator.nodeModules(root);
+    } else if (shape == "many-small-repos") {
+      generator.manySmallRepositories(root);
+    } else if (shape == "home") {
+      generator.home(root);
+    } else {
+      std::cerr << "Unknown shape " << shape << std::endl;
+      return 1;
+    }
+  } catch (const fs::filesystem_error &exception) {
+    std::cerr << exception.what() << std::endl;
+    return 1;
+  }
+
+  if (inMemory) {
+    if (output.has_parent_path()) {
+      fs::create_directories(output.parent_path(), error);
+    }
+    std::ofstream snapshot(output, std::ios::binary);
+    TreeGenerator::writeSnapshot(snapshot, ".", *generator.snapshot, 0, shape == "dt-unknown");
+    if (!snapshot.flush()) {
+      std::cerr << "Could not write " << output << std::endl;
+      return 1;
+    }
+  }
+
+  std::cout << "{\"directories\":" << generator.numDirectories
+    << ",\"files\":" << generator.numFiles
+    << ",\"repositories\":" << generator.numRepositories << "}" << std::endl;
+  return 0;
+}
@@ -0,0 +1,230 @@
+// Benchmarks findGitRepos against reproducible trees made by generateTree, and prints the results as JSON.
+//
+// Build with `node-gyp rebuild --build_benchmarks=1`, then run:
+//   node bench/run.js [--shapes wide,deep,node_modules,many-small-repos,home,dt-unknown] [--seed 1]
+//     [--size 50000] [--runs 5] [--concurrency 1] [--prioritize 0] [--snapshot 0] [--latencyUS 0]
+//     [--root <dir>] [--output <file>]
+//
+// Every measurement runs in a fresh process so peak RSS is its own. Cold runs drop the page cache first,
+// which needs root on Linux. They are reported as skipped when that is not possible. Pass --prioritize 1
+// to search with the prioritized frontier, and compare timeTo90PercentRecallMS between both.
+//
+// Pass --snapshot 1 to search snapshots of the trees held in memory instead, with --latencyUS added to
+// every directory listed and entry looked up. Those runs measure the traversal, the frontier and the
+// delivery of progress without the disk, at sizes a disk would not hold. Their results are labeled
+// provider-only, and count the calls to the provider rather than system calls.
+//
+// The dt-unknown shape is the wide tree searched with every entry reported without a type. On disk, the
+// benchmark build hides the types getdents returns, so the lookups go through the same batched statx
+// calls as on file systems that do not report types. As a snapshot, its listings report no types.
+
+const { execFileSync, execSync } = require('child_process');
+const fs = require('fs');
+const os = require('os');
+const path = require('path');
+
+const buildPath = path.resolve(__dirname, '..', 'build', 'Release');
+const allShapes = ['wide', 'deep', 'node_modules', 'many-small-repos', 'home', 'dt-unknown'];
+
+const parseArguments = argv => {
+  const options = {
+    shapes: allShapes,
+    seed: 1,
+    size: 50000,
+    runs: 5,
+    concurrency: 1,
+    prioritize: 0,
+    snapshot: 0,
+    latencyUS: 0,
+    root: path.join(os.tmpdir(), 'find-git-repositories-bench'),
+    output: null
+  };
+
+  for (let i = 0; i < argv.length; i += 2) {
+    const name = argv[i].replace(/^--/, '');
+    const value = argv[i + 1];
+    if (!(name in options) || value === undefined) {
+      throw new Error(`Unknown or incomplete argument ${argv[i]}`);
+    }
+    options[name] = name === 'shapes'
+      ? value.split(',')
+      : (typeof options[name] === 'number' ? Number(value) : value);
+  }
+
+  return options;
+};
+
+const median = values => {
+  const sorted = values.slice().sort((a, b) => a - b);
+  return sorted[Math.floor(sorted.length / 2)];
+};
+
+const dropPageCache = () => {
+  if (process.platform !== 'linux') {
+    return false;
+  }
+
+  try {
+    execSync('sync');
+    fs.writeFileSync('/proc/sys/vm/drop_caches', '3');
+    return true;
+  } catch (error) {
+    return false;
+  }
+};
+
+// Runs in the child process: one search, measured from the inside.
+const measure = async ({ treePath, concurrency, prioritize, snapshot, latencyUS }) => {
+  const findGitRepos = require('..');
+  // A snapshot is loaded before the clock starts, and searched from its root.
+  const fileSystem = snapshot
+    ? await findGitRepos.loadSnapshot(treePath, { listLatencyUS: latencyUS, statLatencyUS: latencyUS })
+    : null;
+  const start = process.hrtime.bigint();
+  // When each batch of repositories reached the callback, to tell how soon most of them were known.
+  const batches = [];
+  const onProgress = paths => {
+    batches.push({ atMS: Number(process.hrtime.bigint() - start) / 1e6, count: paths.length });
+  };
+  const searchOptions = { stats: true, concurrency, prioritize: Boolean(prioritize) };
+  if (fileSystem) {
+    searchOptions.fileSystem = fileSystem;
+  }
+  return findGitRepos(fileSystem ? '.' : treePath, onProgress, searchOptions).then(({ repositories, stats }) => {
+    const wallMS = Number(process.hrtime.bigint() - start) / 1e6;
+    let timeTo90PercentRecallMS = wallMS;
+    for (let i = 0, reported = 0; i < batches.length; ++i) {
+      reported += batches[i].count;
+      if (reported >= repositories.length * 0.9) {
+        timeTo90PercentRecallMS = batches[i].atMS;
+        break;
+      }
+    }
+    const failedOpens = Object.values(stats.failedOpens).reduce((sum, count) => sum + count, 0);
+    return {
+      wallMS,
+      repositories: repositories.length,
+      directories: stats.directoriesOpened,
+      entries: stats.entriesRead,
+      dirsPerSec: stats.directoriesOpened / (wallMS / 1000),
+      entriesPerSec: stats.entriesRead / (wallMS / 1000),
+      timeToFirstRepositoryMS: stats.timeToFirstRepositoryMS,
+      timeTo90PercentRecallMS,
+      traversalCpuMS: stats.phases.traversal.cpuMS,
+      peakRssBytes: process.resourceUsage().maxRSS * 1024,
+      ...(snapshot
+        ? { providerCalls: { list: stats.directoriesOpened, stat: stats.statFallbacks } }
+        : { syscalls: { open: stats.directoriesOpened + failedOpens, read: stats.directoryReads, stat: stats.statFallbacks } })
+    };
+  });
+};
+
+const runChild = (treePath, options, snapshot, hideEntryTypes) => {
+  const { concurrency, prioritize, latencyUS } = options;
+  const env = hideEntryTypes ? { ...process.env, FIND_GIT_REPOS_HIDE_ENTRY_TYPES: '1' } : process.env;
+  const output = execFileSync(process.execPath, [
+    __filename,
+    '--child',
+    JSON.stringify({ treePath, concurrency, prioritize, snapshot, latencyUS })
+  ], { env });
+  const result = JSON.parse(output.toString());
+  if (hideEntryTypes && result.directories > 1 && !result.syscalls.stat) {
+    throw new Error('Entry types were not hidden, rebuild with `node-gyp rebuild --build_benchmarks=1`');
+  }
+  return result;
+};
+
+const summarize = runs => ({
+  runs: runs.length,
+  wallMS: median(runs.map(run => run.wallMS)),
+  dirsPerSec: median(runs.map(run => run.dirsPerSec)),
+  entriesPerSec: median(runs.map(run => run.entriesPerSec)),
+  timeToFirstRepositoryMS: median(runs.map(run => run.timeToFirstRepositoryMS)),
+  timeTo90PercentRecallMS: median(runs.map(run => run.timeTo90PercentRecallMS)),
+  traversalCpuMS: median(runs.map(run => run.traversalCpuMS)),
+  peakRssBytes: Math.max(...runs.map(run => run.peakRssBytes)),
+  repositories: runs[0].repositories,
+  directories: runs[0].directories,
+  entries: runs[0].entries,
+  syscalls: runs[0].syscalls,
+  providerCalls: runs[0].providerCalls
+});
+
+const main = () => {
+  const options = parseArguments(process.argv.slice(2));
+  const generateTree = path.join(buildPath, process.platform === 'win32' ? 'generateTree.exe' : 'generateTree');
+  if (!fs.existsSync(generateTree)) {
+    throw new Error('generateTree is missing, build it with `node-gyp rebuild --build_benchmarks=1`');
+  }
+
+  const results = options.shapes.map(shape => {
+    if (!allShapes.includes(shape)) {
+      throw new Error(`Unknown shape ${shape}`);
+    }
+
+    const snapshot = Boolean(options.snapshot);
+    const hideEntryTypes = !snapshot && shape === 'dt-unknown';
+    const treePath = path.join(options.root, snapshot ? `${shape}.snapshot` : shape);
+    const tree = JSON.parse(execFileSync(generateTree, [
+      ...(snapshot ? ['--snapshot'] : []),
+      treePath,
+      shape,
+      String(options.seed),
+      String(options.size)
+    ]).toString());
+
+    let cold = { skipped: 'snapshots are held in memory' };
+    if (!snapshot) {
+      cold = dropPageCache()
+        ? summarize([runChild(treePath, options, snapshot, hideEntryTypes)])
+        : { skipped: 'could not drop the page cache' };
+    }
+
+    // The first warm run only fills the cache.
+    runChild(treePath, options, snapshot, hideEntryTypes);
+    const warmRuns = [];
+    for (let i = 0; i < options.runs; ++i) {
+      warmRuns.push(runChild(treePath, options, snapshot, hideEntryTypes));
+    }
+
+    return {
+      shape,
+      searched: snapshot ? 'provider-only' : 'disk',
+      seed: options.seed,
+      size: options.size,
+      tree,
+      cold,
+      warm: summarize(warmRuns)
+    };
+  });
+
+  const report = JSON.stringify({
+    version: require('../package.json').version,
+    node: process.version,
+    platform: process.platform,
+    arch: process.arch,
+    cpus: os.cpus().length,
+    concurrency: options.concurrency,
+    prioritize: Boolean(options.prioritize),
+    snapshot: Boolean(options.snapshot),
+    latencyUS: options.latencyUS,
+    results
+  }, null, 2);
+
+  if (options.output) {
+    fs.writeFileSync(options.output, report);
+  } else {
+    process.stdout.write(`${report}\n`);
+  }
+};
+
+if (process.argv[2] === '--child') {
+  measure(JSON.parse(process.argv[3]))
+    .then(result => process.stdout.write(JSON.stringify(result)))
+    .catch(error => {
+      process.stderr.write(`${error.stack}\n`);
+      process.exit(1);
+    });
+} else {
+  main();
+}
@@ -1,14 +1,66 @@
 {
+    "variables": {
+        "build_benchmarks%": 0,
+        "build_cli%": 0
+    },
     "targets": [{
+        "target_name": "findGitReposEngine",
+        "type": "static_library",
+
+        "sources": [
+            "cpp/src/BackgroundMode.cpp",
+            "cpp/src/MemoryFileSystem.cpp",
+            "cpp/src/PathMatcher.cpp",
+            "cpp/src/PriorityFrontier.cpp",
+            "cpp/src/RepositoryInfo.cpp",
+            "cpp/src/RepositoryScanner.cpp",
+            "cpp/src/ScanScope.cpp",
+            "cpp/src/ScanStats.cpp",
+            "cpp/src/VisitedSet.cpp"
+        ],
+        "include_dirs": [
+            "cpp/includes"
+        ],
+        "direct_dependent_settings": {
+            "include_dirs": [
+                "cpp/includes"
+            ]
+        },
+        "conditions": [
+            ["OS=='mac'", {
+                "cflags+": ["-fvisibility=hidden"],
+                "xcode_settings": {
+                    "GCC_SYMBOLS_PRIVATE_EXTERN": "YES"
+                }
+            }],
+            ["OS=='linux'", {
+                "sources": [
+                    "cpp/src/LinuxDirectory.cpp",
+                    "cpp/src/MountTable.cpp",
+                    "cpp/src/StatBatch.cpp"
+                ]
+            }],
+            ["OS=='mac' or OS=='linux'", {
+                "sources": [
+                    "cpp/src/ScanIndex.cpp"
+                ]
+            }],
+            ["build_benchmarks==1", {
+                "defines": ["FIND_GIT_REPOS_BENCHMARKS"]
+            }]
+        ]
+    }, {
         "target_name": "findGitRepos",
 
         "dependencies": [
-            "vendor/openpa/openpa.gyp:openpa"
+            "findGitReposEngine"
         ],
 
         "sources": [
+            "cpp/src/ArgumentParsing.cpp",
             "cpp/src/FindGitRepos.cpp",
-            "cpp/src/Queue.cpp"
+            "cpp/src/Queue.cpp",
+            "cpp/src/ScanCoordinator.cpp"
         ],
         "include_dirs": [
             "<!(node -p \"require('node-addon-api').include_dir\")",
@@ -25,10 +77,6 @@
                         "AdditionalOptions": [ "/ignore:4248" ]
                     },
                 },
-                "defines": [
-                    "OPA_HAVE_NT_INTRINSICS=1",
-                    "_opa_inline=__inline"
-                ],
                 "conditions": [
                     ["target_arch=='x64'", {
                         "VCLibrarianTool": {
@@ -51,24 +99,47 @@
                     "GCC_SYMBOLS_PRIVATE_EXTERN": "YES"
                 }
             }],
-            ["OS=='mac' or OS=='linux'", {
-                "defines": [
-                    "OPA_HAVE_GCC_INTRINSIC_ATOMICS=1",
-                    "HAVE_STDDEF_H=1",
-                    "HAVE_STDLIB_H=1",
-                    "HAVE_UNISTD_H=1"
-                ]
-            }],
-            ["target_arch=='x64' or target_arch=='arm64'", {
-                "defines": [
-                    "OPA_SIZEOF_VOID_P=8"
+            ["OS=='linux'", {
+                "sources": [
+                    "cpp/src/RepositoryWatcher.cpp"
                 ]
             }],
-            ["target_arch=='ia32' or target_arch=='armv7'", {
-                "defines": [
-                    "OPA_SIZEOF_VOID_P=4"
+        ],
+    }],
+    "conditions": [
+        ["build_benchmarks==1", {
+            "targets": [{
+                "target_name": "generateTree",
+                "type": "executable",
+                "sources": [
+                    "bench/generateTree.cpp"
+                ],
+                "cflags_cc": ["-std=c++17"],
+                "cflags_cc!": ["-fno-exceptions"],
+                "xcode_settings": {
+                    "CLANG_CXX_LANGUAGE_STANDARD": "c++17",
+                    "GCC_ENABLE_CPP_EXCEPTIONS": "YES",
+                    "MACOSX_DEPLOYMENT_TARGET": "10.15"
+                },
+                "msvs_settings": {
+                    "VCCLCompilerTool": {
+                        "AdditionalOptions": [ "/std:c++17" ],
+                        "ExceptionHandling": 1
+                    }
+                }
+            }]
+        }],
+        ["build_cli==1", {
+            "targets": [{
+                "target_name": "find-git-repos",
+                "type": "executable",
+                "dependencies": [
+                    "findGitReposEngine"
+                ],
+                "sources": [
+                    "cpp/cli/FindGitReposCli.cpp"
                 ]
             }]
-        ],
-    }]
+        }]
+    ]
 }
@@ -0,0 +1,281 @@
+// Command line front end of the scanner, for scripts and profiling without a JS runtime. Prints every
+// repository as soon as it is found, one per line or NUL terminated.
+//
+// Usage: find-git-repos [options] <path>...
+//
+// Prints the .git directory of every repository, like findGitRepos, or with --classify its kind, work
+// tree, git directory and branch separated by tabs.
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "../includes/MemoryFileSystem.h"
+#include "../includes/RepositoryInfo.h"
+#include "../includes/RepositoryScanner.h"
+
+namespace {
+  const char *const kUsage =
+    "Usage: find-git-repos [options] <path>...\n"
+    "\n"
+    "Options:\n"
+    "  -0, --null                    end every result with NUL instead of a newline\n"
+    "  --classify                    print kind, work tree, git directory and branch separated by tabs\n"
+    "  --read-head                   read the branch of every repository, with --classify\n"
+    "  --max-depth <n>               search at most n levels of subfolders\n"
+    "  --exclude <pattern>           skip directories matching a glob pattern, may be repeated\n"
+    "  --include <pattern>           never skip directories matching a glob pattern, may be repeated\n"
+    "  --concurrency <n>             number of traversal threads, 1 to 256 (default 1)\n"
+    "  --frontier-memory-mb <n>      memory for directories waiting to be searched (default 64)\n"
+    "  --index <path>                index file reused by the next search (not on Windows)\n"
+    "  --one-file-system             stay on the file systems of the paths (Linux)\n"
+    "  --skip-pseudo-file-systems    skip proc, sysfs and other virtual file systems (Linux)\n"
+    "  --skip-file-system-type <t>   skip mounts of a file system type, may be repeated (Linux)\n"
+    "  --prioritize                  search likely repository folders first\n"
+    "  --hint <path>                 search a path and the way to it first, may be repeated\n"
+    "  --deadline-ms <n>             stop after n milliseconds\n"
+    "  --max-directories <n>         stop after n directories\n"
+    "  --background                  search with the lowest I/O and CPU priority\n"
+    "  --directories-per-second <n>  read at most n directories per second, implies --background\n"
+    "  --cache-hints                 spare the page cache, implies --background (Linux)\n"
+    "  --snapshot <file>             search a tree snapshot in memory instead of the disk, from \".\"\n"
+    "  --list-latency-us <n>         add n microseconds to every directory listed from the snapshot\n"
+    "  --stat-latency-us <n>         add n microseconds to every entry looked up in the snapshot\n"
+    "  --read-latency-us <n>         add n microseconds to every file read from the snapshot\n"
+    "  --stats                       print counters of the search to stderr once done\n"
+    "  -h, --help                    print this help\n";
+
+  // Delivered output is flushed at most this often, so a reader at the other end of a pipe sees the
+  // repositories early without a write for each of them.
+  const std::chrono::milliseconds kFlushInterval(50);
+
+  class OutputSink: public ScanSink {
+  public:
+    OutputSink(bool classify, char terminator):
+      mClassify(classify),
+      mTerminator(terminator),
+      mUnflushed(false),
+      mLastFlush(std::chrono::steady_clock::now())
+    {}
+
+    void repositoryFound(std::uint32_t threadIndex, const std::string &record) override {
+      std::string line;
+      if (mClassify) {
+        // kind, path, gitDir and branch, each NUL terminated.
+        const char *field = record.data();
+        line = repositoryKindName((RepositoryKind)field[0]);
+        for (size_t i = 1; i < kRepositoryInfoFields; ++i) {
+          field += strlen(field) + 1;
+          line += '\t';
+          line += field;
+        }
+      } else {
+        line = record;
+      }
+      line += mTerminator;
+
+      std::lock_guard<std::mutex> lock(mMutex);
+      fwrite(line.data(), 1, line.size(), stdout);
+      mUnflushed = true;
+    }
+
+    void heartbeat() override {
+      if (!mUnflushed) {
+        return;
+      }
+
+      std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+      const auto now = std::chrono::steady_clock::now();
+      if (!lock.owns_lock() || now - mLastFlush < kFlushInterval) {
+        return;
+      }
+
+      fflush(stdout);
+      mUnflushed = false;
+      mLastFlush = now;
+    }
+
+  private:
+    const bool mClassify;
+    const char mTerminator;
+    std::mutex mMutex;
+    std::atomic<bool> mUnflushed;
+    std::chrono::steady_clock::time_point mLastFlush;
+  };
+
+  bool parseNumber(const char *text, std::uint32_t min, std::uint32_t max, std::uint32_t &value) {
+    char *end = nullptr;
+    const unsigned long long number = strtoull(text, &end, 10);
+    if (!*text || *end || number < min || number > max) {
+      return false;
+    }
+
+    value = (std::uint32_t)number;
+    return true;
+  }
+
+  void printStats(const ScanSummary &summary) {
+    const TraversalStats &stats = summary.stats;
+    fprintf(
+      stderr,
+      "{\"directoriesOpened\":%llu,\"directoriesFromIndex\":%llu,\"directoryReads\":%llu,\"entriesRead\":%llu,"
+      "\"statFallbacks\":%llu,\"repositoriesFound\":%llu,\"directoriesLeft\":%llu,\"timeToFirstRepositoryMS\":%.3f,"
+      "\"traversalWallMS\":%.3f,\"traversalCpuMS\":%.3f}\n",
+      (unsigned long long)stats.directoriesOpened,
+      (unsigned long long)stats.directoriesFromIndex,
+      (unsigned long long)stats.directoryReads,
+      (unsigned long long)stats.entriesRead,
+      (unsigned long long)stats.statFallbacks,
+      (unsigned long long)stats.repositoriesFound,
+      (unsigned long long)summary.directoriesLeft,
+      summary.firstRepositoryNS < 0 ? -1.0 : summary.firstRepositoryNS / 1e6,
+      summary.traversalPhase.wallTimeNS / 1e6,
+      stats.cpuTimeNS / 1e6
+    );
+  }
+}
+
+int main(int argc, char **argv) {
+  SearchOptions searchOptions;
+  std::vector<std::string> paths;
+  char terminator = '\n';
+  bool printCounters = false;
+  std::string snapshotPath;
+  SimulatedLatency latency;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument = argv[i];
+    // Options taking a value read it from the next argument.
+    const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+    bool tookValue = false;
+    bool valid = true;
+
+    if (argument == "-h" || argument == "--help") {
+      fputs(kUsage, stdout);
+      return 0;
+    } else if (argument == "-0" || argument == "--null") {
+      terminator = '\0';
+    } else if (argument == "--classify") {
+      searchOptions.classify = true;
+    } else if (argument == "--read-head") {
+      searchOptions.readHead = true;
+    } else if (argument == "--one-file-system") {
+      searchOptions.oneFileSystem = true;
+    } else if (argument == "--skip-pseudo-file-systems") {
+      searchOptions.skipPseudoFileSystems = true;
+    } else if (argument == "--prioritize") {
+      searchOptions.prioritize = true;
+    } else if (argument == "--background") {
+      searchOptions.background = true;
+    } else if (argument == "--cache-hints") {
+      searchOptions.background = searchOptions.cacheHints = true;
+    } else if (argument == "--stats") {
+      printCounters = true;
+    } else if (argument == "--max-depth") {
+      valid = value && parseNumber(value, 0, UINT32_MAX, searchOptions.maxSubfolderDeep);
+      tookValue = true;
+    } else if (argument == "--concurrency") {
+      valid = value && parseNumber(value, 1, 256, searchOptions.concurrency);
+      tookValue = true;
+    } else if (argument == "--frontier-memory-mb") {
+      std::uint32_t megabytes = 0;
+      valid = value && parseNumber(value, 1, 1024 * 1024, megabytes);
+      searchOptions.frontierMemoryLimit = (size_t)megabytes * 1024 * 1024;
+      tookValue = true;
+    } else if (argument == "--deadline-ms") {
+      valid = value && parseNumber(value, 1, UINT32_MAX, searchOptions.deadlineMS);
+      tookValue = true;
+    } else if (argument == "--max-directories") {
+      valid = value && parseNumber(value, 1, UINT32_MAX, searchOptions.maxDirectories);
+      tookValue = true;
+    } else if (argument == "--directories-per-second") {
+      valid = value && parseNumber(value, 1, UINT32_MAX, searchOptions.directoriesPerSecond);
+      searchOptions.background = true;
+      tookValue = true;
+    } else if (argument == "--exclude" || argument == "--include") {
+      valid = value && *value && (
+        argument == "--exclude" ? searchOptions.pathMatcher.addExclude(value) : searchOptions.pathMatcher.addInclude(value)
+      );
+      tookValue = true;
+    } else if (argument == "--index") {
+      valid = value && *value;
+      if (valid) {
+        searchOptions.indexPath = value;
+      }
+      tookValue = true;
+    } else if (argument == "--skip-file-system-type") {
+      valid = value && *value;
+      if (valid) {
+        searchOptions.skipFileSystemTypes.insert(value);
+      }
+      tookValue = true;
+    } else if (argument == "--hint") {
+      valid = value && *value;
+      if (valid) {
+        searchOptions.ranker.addHint(value);
+        searchOptions.prioritize = true;
+      }
+      tookValue = true;
+    } else if (argument == "--snapshot") {
+      valid = value && *value;
+      if (valid) {
+        snapshotPath = value;
+      }
+      tookValue = true;
+    } else if (argument == "--list-latency-us") {
+      valid = value && parseNumber(value, 0, UINT32_MAX, latency.listMicroseconds);
+      tookValue = true;
+    } else if (argument == "--stat-latency-us") {
+      valid = value && parseNumber(value, 0, UINT32_MAX, latency.statMicroseconds);
+      tookValue = true;
+    } else if (argument == "--read-latency-us") {
+      valid = value && parseNumber(value, 0, UINT32_MAX, latency.readMicroseconds);
+      tookValue = true;
+    } else if (argument == "--") {
+      paths.insert(paths.end(), argv + i + 1, argv + argc);
+      break;
+    } else if (argument.empty() || (argument.size() > 1 && argument[0] == '-')) {
+      valid = false;
+    } else {
+      paths.push_back(argument);
+    }
+
+    if (!valid) {
+      fprintf(stderr, "find-git-repos: invalid option %s%s%s\n\n%s", argv[i], tookValue ? " " : "", tookValue && value ? value : "", kUsage);
+      return 2;
+    }
+    i += tookValue ? 1 : 0;
+  }
+
+  if (paths.empty()) {
+    fputs(kUsage, stderr);
+    return 2;
+  }
+
+  if (!snapshotPath.empty()) {
+    std::shared_ptr<MemoryFileSystem> fileSystem(new MemoryFileSystem(latency));
+    std::string error;
+    if (!fileSystem->load(snapshotPath, error)) {
+      fprintf(stderr, "find-git-repos: could not load the snapshot: %s\n", error.c_str());
+      return 1;
+    }
+    searchOptions.fileSystem = fileSystem;
+  }
+
+  OutputSink sink(searchOptions.classify, terminator);
+  std::atomic<bool> cancel(false);
+  RepositoryScanner scanner(paths, searchOptions, sink, cancel);
+  scanner.run();
+  fflush(stdout);
+
+  if (printCounters) {
+    printStats(scanner.summary());
+  }
+  return 0;
+}
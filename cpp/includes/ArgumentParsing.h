@@ -0,0 +1,61 @@
+#ifndef ARGUMENT_PARSING_H
+#define ARGUMENT_PARSING_H
+
+#include <napi.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "MemoryFileSystem.h"
+#include "RepositoryScanner.h"
+
+// Reads the arguments of the functions the addon exports. Every Parse*Options function returns the message
+// of the first invalid option, or an empty string.
+
+// Marks the objects resolved by findGitRepos.loadSnapshot, which wrap the snapshot they loaded.
+extern const napi_type_tag kSnapshotTypeTag;
+
+// The options of findGitRepos beside the ones of the search itself.
+struct FindOptions {
+  FindOptions():
+    collectRepositories(true),
+    coalesce(false),
+    cacheTTLMS(0)
+  {}
+
+  bool collectRepositories;
+  bool coalesce;
+  std::uint32_t cacheTTLMS;
+};
+
+struct StreamOptions {
+  StreamOptions():
+    highWaterMark(1024),
+    lowWaterMark(512)
+  {}
+
+  std::uint32_t highWaterMark;
+  std::uint32_t lowWaterMark;
+};
+
+struct WatchOptions {
+  WatchOptions():
+    maxWatches(8192),
+    pollIntervalMS(5000)
+  {}
+
+  std::uint32_t maxWatches;
+  std::uint32_t pollIntervalMS;
+};
+
+// A search starts from a single path or from an array of them.
+bool ParseRoots(const Napi::Value &value, std::vector<std::string> &roots);
+// The options shared by findGitRepos and findGitRepos.stream.
+std::string ParseSearchOptions(const Napi::Object &options, SearchOptions &searchOptions);
+std::string ParseFindOptions(const Napi::Object &options, SearchOptions &searchOptions, FindOptions &findOptions);
+// lowWaterMark defaults to half of highWaterMark.
+std::string ParseStreamOptions(const Napi::Object &options, SearchOptions &searchOptions, StreamOptions &streamOptions);
+std::string ParseSnapshotOptions(const Napi::Object &options, SimulatedLatency &latency);
+// The search options a watcher cannot keep current are rejected.
+std::string ParseWatchOptions(const Napi::Object &options, SearchOptions &searchOptions, WatchOptions &watchOptions);
+
+#endif
@@ -0,0 +1,38 @@
+#ifndef BACKGROUND_MODE_H
+#define BACKGROUND_MODE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+struct ThreadPriority {
+  bool ioLowered;
+  bool cpuLowered;
+};
+
+// Lowers the I/O and CPU priority of the calling thread for the rest of its life: the idle I/O class and
+// SCHED_IDLE (or the highest niceness) on Linux, the background QoS class on macOS, the background mode
+// on Windows. An unprivileged thread cannot raise them back, so only threads that end with the search may
+// call this. Reports what the platform allowed.
+ThreadPriority lowerThreadPriority();
+
+// Token bucket shared by the traversal threads, refilled at a fixed number of tokens per second and
+// holding at most a tenth of a second of them, so the threads never burst far above the rate. Tokens are
+// reserved in the order threads ask for them, a thread that has to wait sleeps until its token is due.
+class RateLimiter {
+public:
+  explicit RateLimiter(std::uint32_t tokensPerSecond);
+
+  // Takes a token, waiting for it unless cancel gets set meanwhile. Returns the nanoseconds waited.
+  std::uint64_t acquire(const std::atomic<bool> &cancel);
+
+private:
+  const double mTokensPerSecond;
+  const double mCapacity;
+  std::mutex mMutex;
+  double mTokens;
+  std::chrono::steady_clock::time_point mLastRefill;
+};
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef FILE_SYSTEM_PROVIDER_H
+#define FILE_SYSTEM_PROVIDER_H
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// What a directory listing says an entry is. Unknown entries are looked up with status, like on file
+// systems that do not report entry types.
+enum class EntryType: std::uint8_t {
+  Unknown,
+  Directory,
+  File,
+  Symlink,
+  Other
+};
+
+struct EntryStatus {
+  std::uint64_t device;
+  std::uint64_t inode;
+  bool isDirectory;
+};
+
+// The file system calls of a search, for searches that do not read the disk through the native backends,
+// such as a search of an in-memory snapshot. Every function is called by the traversal threads,
+// concurrently. Paths are built by the search, from a root it was given and the names listed below it,
+// joined with the separator of the platform. Errors are errno values, as stats.failedOpens reports them.
+class FileSystemProvider {
+public:
+  typedef std::function<bool(const char *name, EntryType type)> EntryCallback;
+
+  virtual ~FileSystemProvider() {}
+
+  // Calls onEntry for every entry of a directory but . and .., until it returns false. Returns 0, or the
+  // error that kept the directory from being opened.
+  virtual int listDirectory(const std::string &path, const EntryCallback &onEntry) = 0;
+  // Like lstat, or like stat with followSymlink. Returns 0 or an error.
+  virtual int status(const std::string &path, bool followSymlink, EntryStatus &status) = 0;
+  // Reads up to maxSize bytes of a file.
+  virtual bool readFile(const std::string &path, std::string &contents, size_t maxSize) = 0;
+};
+
+#endif
@@ -0,0 +1,18 @@
+#ifndef FRONTIER_H
+#define FRONTIER_H
+
+// Pending directories of one traversal thread. A thread takes work from its own frontier and steals from
+// the frontiers of the other threads once its own is empty. The order in which directories come out is up
+// to the implementation. depthFirst is set while the pending directories use too much memory, and asks
+// for the order that keeps the fewest of them pending.
+template <typename T>
+class Frontier {
+public:
+  virtual ~Frontier() {}
+
+  virtual void push(T item) = 0;
+  virtual bool pop(T &item, bool depthFirst) = 0;
+  virtual bool steal(T &item, bool depthFirst) = 0;
+};
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef LINUX_DIRECTORY_H
+#define LINUX_DIRECTORY_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+
+// A directory discovered during the traversal, stored as its name relative to the parent directory. Open
+// parents keep their descriptor around while they still have children to scan, so the kernel only has to
+// resolve a single path component per directory. Full paths are only built when something is reported.
+class DirectoryNode {
+public:
+  explicit DirectoryNode(std::string rootPath);
+  DirectoryNode(std::shared_ptr<DirectoryNode> parent, std::string name);
+  ~DirectoryNode();
+
+  // With noAccessTime, reading the directory leaves its access time alone where the process may ask so.
+  int openDescriptor(bool noAccessTime);
+  void releaseDescriptor(bool hasChildren);
+  int status(struct stat *statBuffer) const;
+  const std::string &name() const;
+  std::string path() const;
+  size_t memoryUsage() const;
+
+private:
+  const DirectoryNode *closestOpenAncestor(std::string &relativePath) const;
+
+  const std::shared_ptr<DirectoryNode> mParent;
+  const std::string mName;
+  int mDescriptor;
+  bool mRetained;
+};
+
+// Reads directory entries with getdents64 in large batches. Each traversal thread owns one reader so the
+// batch buffer is reused for every directory.
+class DirectoryReader {
+public:
+  DirectoryReader();
+
+  void reset(int descriptor);
+  // Returns false at the end of the directory, or when a read failed partway through it.
+  bool next(const char *&name, unsigned char &type);
+  size_t numReads() const;
+  // The errno of the read that ended the directory early, 0 when it was read to the end.
+  int error() const;
+
+private:
+  std::vector<char> mBuffer;
+  int mDescriptor;
+  size_t mNumReads;
+  int mError;
+  long mBufferLength;
+  long mBufferOffset;
+};
+
+// Reads up to maxSize bytes of a file relative to a directory descriptor, without following a symlink in
+// its last component. With cacheHints, the access time of the file is left alone where the process may
+// ask so, and the kernel is told its pages will not be needed again.
+bool readFileAt(int directoryDescriptor, const std::string &path, std::string &contents, size_t maxSize, bool cacheHints);
+
+#endif
@@ -0,0 +1,70 @@
+#ifndef MEMORY_FILE_SYSTEM_H
+#define MEMORY_FILE_SYSTEM_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "FileSystemProvider.h"
+
+// Added to every call, to weigh a search of a snapshot like one of a disk or a network file system.
+struct SimulatedLatency {
+  SimulatedLatency():
+    listMicroseconds(0),
+    statMicroseconds(0),
+    readMicroseconds(0)
+  {}
+
+  std::uint32_t listMicroseconds;
+  std::uint32_t statMicroseconds;
+  std::uint32_t readMicroseconds;
+};
+
+// A read-only tree held in memory, loaded from a snapshot, so traversals of trees far larger than a dev
+// box holds can be measured without a disk or page cache in the way. Paths are resolved from the root of
+// the snapshot, whatever their separators and leading separators: a search of "." covers all of it.
+//
+// A snapshot is a text file with one line per entry, in the order of a depth-first walk:
+//   <depth>\t<type>\t<name>[\t<contents>]
+// The root comes first at depth 0, its name is ignored. The type is d for a directory, f for a file, l for
+// a symlink and any other letter for other entries. In upper case, the listing reports the entry type as
+// unknown and the search has to look it up. The contents of a file are optional, with newlines, tabs and
+// backslashes escaped as in C. `find <root> -printf '%d\t%y\t%f\n'` writes a snapshot of a real tree,
+// without contents.
+class MemoryFileSystem: public FileSystemProvider {
+public:
+  explicit MemoryFileSystem(const SimulatedLatency &latency);
+
+  // Replaces the tree with the one of a snapshot. On failure error tells why, and the tree is left empty.
+  bool load(const std::string &snapshotPath, std::string &error);
+  size_t numEntries() const;
+
+  int listDirectory(const std::string &path, const EntryCallback &onEntry) override;
+  int status(const std::string &path, bool followSymlink, EntryStatus &status) override;
+  bool readFile(const std::string &path, std::string &contents, size_t maxSize) override;
+
+private:
+  struct Node {
+    // Offsets into mStrings. Names are NUL terminated.
+    std::uint64_t name;
+    std::uint64_t contents;
+    std::uint32_t contentsLength;
+    std::uint32_t parent;
+    // Range of mChildren.
+    std::uint32_t firstChild;
+    std::uint32_t numChildren;
+    EntryType type;
+    bool listedAsUnknown;
+  };
+
+  // Returns 0 and the index of the node at path, or an error.
+  int find(const std::string &path, std::uint32_t &index) const;
+  const char *name(std::uint32_t index) const;
+
+  const SimulatedLatency mLatency;
+  std::vector<Node> mNodes;
+  // The children of every directory, next to each other and sorted by name.
+  std::vector<std::uint32_t> mChildren;
+  std::string mStrings;
+};
+
+#endif
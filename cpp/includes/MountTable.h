@@ -0,0 +1,48 @@
+#ifndef MOUNT_TABLE_H
+#define MOUNT_TABLE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct Mount {
+  std::string path;
+  std::string fileSystemType;
+  std::uint64_t device;
+};
+
+// The mounts of the calling process, read once from /proc/self/mountinfo. The traversal keeps track of
+// the mount each pending directory is on. Only directories above a mount point have their path looked up
+// here, so the rest of the tree is not slowed down by it.
+class MountTable {
+public:
+  bool load(const char *mountInfoPath = "/proc/self/mountinfo");
+
+  size_t size() const;
+  const Mount &operator[](size_t index) const;
+
+  // The mount a path is on, or -1 when no mount point is a prefix of it. Paths must be canonical.
+  int findContaining(const std::string &path) const;
+  // The mount whose mount point is exactly path, or -1.
+  int findAt(const std::string &path) const;
+  // Whether a mount point lies somewhere below path.
+  bool hasMountsBelow(const std::string &path) const;
+
+  // Virtual file systems that never hold repositories and can be slow or endless to walk.
+  static bool isPseudoFileSystem(const std::string &fileSystemType);
+
+private:
+  std::vector<Mount> mMounts;
+  // A mount point that is mounted over again maps to the last mount, the one that is visible.
+  std::unordered_map<std::string, size_t> mMountsByPath;
+  std::unordered_set<std::string> mMountAncestors;
+};
+
+// Stats every path on its own detached thread and waits up to the matching timeout for each. Returns
+// whether each path answered in time. A thread stuck on a dead server stays blocked in the kernel, and
+// only keeps the state shared with it alive.
+std::vector<bool> probeMounts(const std::vector<std::string> &paths, const std::vector<std::uint32_t> &timeoutsMS);
+
+#endif
@@ -0,0 +1,59 @@
+#ifndef PATH_MATCHER_H
+#define PATH_MATCHER_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Decides which directories are skipped by the traversal. Patterns are compiled once per search:
+// - a pattern without '/' matches a directory name at any depth. Literal names go in a hash set, names
+//   with wildcards ('*', '?' and '[...]') are matched one by one,
+// - a pattern with '/' is anchored to the search root and matched one path segment at a time, '**'
+//   matching any number of segments. The set of partially matched patterns of a directory is carried to
+//   its children as a State, so no path has to be built to match it.
+// A directory is excluded when it matches an exclude pattern and no include pattern.
+class PathMatcher {
+public:
+  typedef std::uint64_t State;
+  static const size_t kMaxPathSegments = 64;
+
+  PathMatcher();
+
+  bool addExclude(const std::string &pattern);
+  bool addInclude(const std::string &pattern);
+
+  bool empty() const;
+  State initialState() const;
+  bool isExcluded(State state, const char *name, State &childState) const;
+
+private:
+  struct NamePatterns {
+    std::unordered_set<std::string> literals;
+    std::vector<std::string> globs;
+  };
+
+  struct PathPattern {
+    std::vector<std::string> segments;
+    size_t firstPosition;
+    bool exclude;
+  };
+
+  bool addPattern(const std::string &pattern, bool exclude);
+  State closure(const PathPattern &pattern, size_t segment) const;
+  bool matchesName(const NamePatterns &patterns, const std::string &name) const;
+  State transition(State state, const std::string &name, bool &matchesExclude, bool &matchesInclude) const;
+
+  NamePatterns mExcludeNames;
+  NamePatterns mIncludeNames;
+  std::vector<PathPattern> mPathPatterns;
+  std::vector<size_t> mPatternOfPosition;
+  State mAcceptingPositions;
+  State mRecursivePositions;
+  State mInitialState;
+  bool mEmpty;
+};
+
+bool matchGlob(const char *pattern, const char *name);
+
+#endif
@@ -0,0 +1,56 @@
+#ifndef PATH_NODE_H
+#define PATH_NODE_H
+
+#include <memory>
+#include <vector>
+
+// A directory discovered during the traversal, stored as its name and a reference to its parent. Pending
+// directories share their common prefix instead of each holding a full path, and a node is freed as soon
+// as nothing below it is pending. Full paths are only built when a directory is read or reported.
+template <typename String>
+class PathNode {
+public:
+  typedef typename String::value_type Char;
+
+  explicit PathNode(String rootPath):
+    mName(std::move(rootPath))
+  {}
+
+  PathNode(std::shared_ptr<const PathNode> parent, String name):
+    mParent(std::move(parent)),
+    mName(std::move(name))
+  {}
+
+  const String &name() const {
+    return mName;
+  }
+
+  String path(Char separator) const {
+    std::vector<const PathNode *> ancestors;
+    size_t length = 0;
+    for (const PathNode *node = this; node; node = node->mParent.get()) {
+      ancestors.push_back(node);
+      length += node->mName.size() + 1;
+    }
+
+    String result;
+    result.reserve(length);
+    for (auto node = ancestors.rbegin(); node != ancestors.rend(); ++node) {
+      if (node != ancestors.rbegin()) {
+        result += separator;
+      }
+      result += (*node)->mName;
+    }
+    return result;
+  }
+
+  size_t memoryUsage() const {
+    return sizeof(*this) + mName.capacity() * sizeof(Char);
+  }
+
+private:
+  const std::shared_ptr<const PathNode> mParent;
+  const String mName;
+};
+
+#endif
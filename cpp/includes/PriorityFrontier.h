@@ -0,0 +1,162 @@
+#ifndef PRIORITY_FRONTIER_H
+#define PRIORITY_FRONTIER_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include "Frontier.h"
+
+// Per-thread heap of pending directories, highest priority first and in the order they were queued among
+// equal ones. Idle threads steal the best directory of another thread too. Priorities are set by
+// DirectoryRanker when a directory is queued. Directories queued under memory pressure carry a depth-first
+// priority as well, which ranks them until a thread takes a directory with depthFirst cleared: they are
+// then ranked again by their own priority, so the search does not keep draining them once back under the
+// limit.
+template <typename T>
+class PriorityFrontier: public Frontier<T> {
+public:
+  PriorityFrontier():
+    mNextSequence(0),
+    mNumDepthFirst(0)
+  {}
+
+  void push(T item) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const bool depthFirst = item.depthFirstPriority != 0;
+    const std::int32_t priority = depthFirst ? item.depthFirstPriority : item.priority;
+    mNumDepthFirst += depthFirst ? 1 : 0;
+    mItems.push_back({ priority, mNextSequence++, depthFirst, std::move(item) });
+    std::push_heap(mItems.begin(), mItems.end(), comesLater);
+  }
+
+  bool pop(T &item, bool depthFirst) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return take(item, depthFirst);
+  }
+
+  bool steal(T &item, bool depthFirst) override {
+    std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+    return lock.owns_lock() && take(item, depthFirst);
+  }
+
+private:
+  struct Entry {
+    std::int32_t priority;
+    std::uint64_t sequence;
+    bool depthFirst;
+    T item;
+  };
+
+  static bool comesLater(const Entry &a, const Entry &b) {
+    return a.priority != b.priority ? a.priority < b.priority : a.sequence > b.sequence;
+  }
+
+  // Once per return under the limit, and only for the heaps still holding depth-first directories.
+  void rankNormally() {
+    for (Entry &entry : mItems) {
+      if (entry.depthFirst) {
+        entry.priority = entry.item.priority;
+        entry.depthFirst = false;
+      }
+    }
+    std::make_heap(mItems.begin(), mItems.end(), comesLater);
+    mNumDepthFirst = 0;
+  }
+
+  bool take(T &item, bool depthFirst) {
+    if (mItems.empty()) {
+      return false;
+    }
+    if (!depthFirst && mNumDepthFirst) {
+      rankNormally();
+    }
+
+    std::pop_heap(mItems.begin(), mItems.end(), comesLater);
+    mNumDepthFirst -= mItems.back().depthFirst ? 1 : 0;
+    item = std::move(mItems.back().item);
+    mItems.pop_back();
+    return true;
+  }
+
+  std::mutex mMutex;
+  std::vector<Entry> mItems;
+  std::uint64_t mNextSequence;
+  // Entries still ranked by their depth-first priority.
+  size_t mNumDepthFirst;
+};
+
+// Repositories found in a group of sibling directories, or in the groups below them. Each group links to
+// the group of its parent, so a repository counts for its siblings and for the siblings of its parent.
+struct SiblingRepositories {
+  explicit SiblingRepositories(std::shared_ptr<SiblingRepositories> _parent):
+    parent(std::move(_parent)),
+    count(0)
+  {}
+
+  void add() {
+    ++count;
+    if (parent) {
+      ++parent->count;
+    }
+  }
+
+  const std::shared_ptr<SiblingRepositories> parent;
+  std::atomic<std::uint32_t> count;
+};
+
+// Ranks pending directories for a search that wants its first repositories early, from signals that are
+// cheap to know when a directory is queued:
+// - shallow directories come first, like in breadth-first order,
+// - names that often hold repositories (src, code, projects, repos...) are worth a few levels, and half as
+//   much for every level below them,
+// - so are repositories already found next to the parent directory or under its siblings,
+// - hints given by the caller, such as the repositories of a previous search, and the directories leading
+//   to them come before everything else.
+class DirectoryRanker {
+public:
+  // A hint is a directory path, or the path of its .git directory.
+  void addHint(std::string path);
+  bool hasHints() const;
+  // Whether path is a hint or leads to one. Paths are only looked up for the children of directories on a
+  // hint path, which are few.
+  bool isOnHintPath(const std::string &path) const;
+
+  // What a directory is worth beyond its depth.
+  static std::int32_t bonus(std::int32_t parentBonus, bool likelyRepositoryHome, std::uint32_t repositoriesNearby);
+  static std::int32_t rank(std::uint32_t depth, std::int32_t bonus);
+  static std::int32_t rankHinted(std::uint32_t depth);
+  // Over the memory limit, the deepest directories come first to drain the frontier. Only used while the
+  // search is over it, see PriorityFrontier.
+  static std::int32_t rankDepthFirst(std::uint32_t depth);
+
+  template <typename String>
+  static bool isLikelyRepositoryHome(const String &name) {
+    for (const char *home : kRepositoryHomes) {
+      size_t i = 0;
+      for (; home[i] && i < name.size(); ++i) {
+        const auto character = name[i];
+        if ((character >= 'A' && character <= 'Z' ? character - 'A' + 'a' : character) != home[i]) {
+          break;
+        }
+      }
+      if (!home[i] && i == name.size()) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+private:
+  static const size_t kNumRepositoryHomes = 15;
+  static const char *const kRepositoryHomes[kNumRepositoryHomes];
+
+  std::unordered_set<std::string> mHints;
+  std::unordered_set<std::string> mHintAncestors;
+};
+
+#endif
@@ -1,29 +1,49 @@
 #ifndef REPOSITORY_QUEUE_H
 #define REPOSITORY_QUEUE_H
 
+#include <atomic>
+#include <memory>
 #include <string>
-extern "C" {
-#  include <opa_queue.h>
-#  include <opa_primitives.h>
-}
+#include <vector>
 
+// Bounded single-producer/single-consumer ring of NUL terminated repository paths. The path bytes are
+// copied straight into the ring, which is reused as it wraps around. It starts small and doubles up to
+// maxCapacity, so a search finding a handful of repositories does not pay for a large buffer per thread.
+class RepositoryRing {
+public:
+  RepositoryRing(size_t initialCapacity, size_t maxCapacity);
+
+  bool push(const char *repository, size_t length);
+  size_t drain(std::string &batch);
+
+private:
+  // Only the producer calls it, while the consumer has nothing left to read.
+  void grow(size_t length);
+
+  // Owned by the producer. The consumer reaches it through mData and mCapacity, which are published
+  // along with the tail.
+  std::unique_ptr<char[]> mBuffer;
+  std::atomic<char *> mData;
+  std::atomic<size_t> mCapacity;
+  const size_t mMaxCapacity;
+  std::atomic<size_t> mHead;
+  char mHeadPadding[64 - sizeof(std::atomic<size_t>)];
+  std::atomic<size_t> mTail;
+};
+
+// One ring per traversal thread, drained together by the JS thread. A drained batch is every pending path
+// back to back, each followed by a NUL, so it can be turned into JS strings with a single split.
 class RepositoryQueue {
 public:
-  RepositoryQueue();
-  ~RepositoryQueue();
+  RepositoryQueue(size_t numProducers, size_t initialRingCapacity, size_t maxRingCapacity);
 
-  void clear();
-  int count();
-  std::string dequeue();
-  void enqueue(std::string repository);
+  bool enqueue(size_t producer, const std::string &repository);
+  size_t dequeueAll(std::string &batch);
+  size_t numEnqueued() const;
 
 private:
-  struct RepositoryNode {
-    OPA_Queue_element_hdr_t header;
-    std::string repository;
-  };
-  OPA_Queue_info_t mQueue;
-  OPA_int_t mNumRepositories;
+  std::vector<std::unique_ptr<RepositoryRing>> mRings;
+  std::atomic<size_t> mNumEnqueued;
 };
 
 #endif
@@ -0,0 +1,73 @@
+#ifndef REPOSITORY_INFO_H
+#define REPOSITORY_INFO_H
+
+#include <cstddef>
+#include <functional>
+#include <string>
+
+// What the traversal saw in a directory that holds a repository.
+enum class RepositoryLayout {
+  // A .git directory.
+  GitDirectory,
+  // A .git file pointing at the git directory, as in linked worktrees and submodules.
+  GitFile,
+  // HEAD, objects and refs right in the directory.
+  Bare
+};
+
+enum class RepositoryKind : char {
+  Repository = 'r',
+  Worktree = 'w',
+  Submodule = 's',
+  Bare = 'b'
+};
+
+struct RepositoryInfo {
+  RepositoryKind kind;
+  // The work tree, or the directory of a bare repository.
+  std::string path;
+  std::string gitDir;
+  // Empty when HEAD is detached, could not be read or was not asked for.
+  std::string branch;
+};
+
+// Notes the entries of a directory that may make it a repository with a .git file or a bare one. The
+// traversal recognizes .git directories on its own. Entries are taken by name only, the files are read
+// and checked afterwards, so entries of unknown type are fine.
+class RepositoryEntries {
+public:
+  RepositoryEntries();
+
+  void add(const char *name, bool isDirectory);
+  bool hasGitFile() const;
+  bool looksBare() const;
+
+private:
+  bool mGitFile;
+  bool mHead;
+  bool mObjects;
+  bool mRefs;
+};
+
+// Reads the first few kilobytes of a file, given by a path relative to the directory being described or
+// an absolute one. The traversal reads relative to the descriptor of the directory where it has one.
+typedef std::function<bool(const std::string &path, std::string &contents)> ReadRepositoryFile;
+static const size_t kMaxRepositoryFileSize = 4096;
+
+// Fills info from the few small files of the layout. Returns false when they show it is not a repository
+// after all, for instance a .git file without a gitdir line or a HEAD that is not a ref nor a commit.
+bool describeRepository(
+  RepositoryLayout layout,
+  const std::string &directoryPath,
+  char separator,
+  const ReadRepositoryFile &readFile,
+  bool readHead,
+  RepositoryInfo &info
+);
+
+// Records cross threads as their kind, path, git directory and branch, each followed by a NUL.
+static const size_t kRepositoryInfoFields = 4;
+std::string encodeRepositoryInfo(const RepositoryInfo &info);
+const char *repositoryKindName(RepositoryKind kind);
+
+#endif
@@ -0,0 +1,133 @@
+#ifndef REPOSITORY_SCANNER_H
+#define REPOSITORY_SCANNER_H
+
+#include <atomic>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+#include "FileSystemProvider.h"
+#include "PathMatcher.h"
+#include "PriorityFrontier.h"
+#include "ScanStats.h"
+
+// Applies to every mount of one file system type. 0 means no limit.
+struct MountLimit {
+  uint32_t concurrency;
+  uint32_t timeoutMS;
+};
+
+// How a search goes. throttleTimeoutMS, collectStats and patterns are only used by the callers of the
+// scanner, to pace their own delivery and to compare searches.
+struct SearchOptions {
+  SearchOptions():
+    throttleTimeoutMS(0),
+    maxSubfolderDeep(0),
+    concurrency(1),
+    frontierMemoryLimit(64 * 1024 * 1024),
+    collectStats(false),
+    latencySampleInterval(0),
+    oneFileSystem(false),
+    skipPseudoFileSystems(false),
+    classify(false),
+    readHead(false),
+    prioritize(false),
+    deadlineMS(0),
+    maxDirectories(0),
+    background(false),
+    directoriesPerSecond(0),
+    cacheHints(false)
+  {}
+
+  uint32_t throttleTimeoutMS;
+  uint32_t maxSubfolderDeep;
+  uint32_t concurrency;
+  size_t frontierMemoryLimit;
+  std::string indexPath;
+  PathMatcher pathMatcher;
+  bool collectStats;
+  uint32_t latencySampleInterval;
+  bool oneFileSystem;
+  bool skipPseudoFileSystems;
+  std::set<std::string> skipFileSystemTypes;
+  std::map<std::string, MountLimit> mountLimits;
+  bool classify;
+  bool readHead;
+  // The exclude and include patterns as passed, prefixed with '-' and '+', to compare searches.
+  std::vector<std::string> patterns;
+  bool prioritize;
+  DirectoryRanker ranker;
+  uint32_t deadlineMS;
+  uint32_t maxDirectories;
+  bool background;
+  uint32_t directoriesPerSecond;
+  bool cacheHints;
+  // Null to read the disk through the native backend of the platform. A search through a provider does
+  // not use an index or look at mounts.
+  std::shared_ptr<FileSystemProvider> fileSystem;
+  // Set when the paths are subtrees of an earlier search of this path, as when the watcher searches a
+  // changed directory again. maxSubfolderDeep and the path patterns then count from it, as they did in
+  // that search, and a path the patterns exclude is not searched at all.
+  std::string subtreeOf;
+};
+
+// Receives what a scan finds. Both functions are called by the traversal threads, concurrently.
+class ScanSink {
+public:
+  virtual ~ScanSink() {}
+
+  // A repository: the path of its .git directory, or a classified record (see encodeRepositoryInfo).
+  // threadIndex is below the concurrency of the search, so a sink can keep state per thread. A sink may
+  // block here to hold the search back.
+  virtual void repositoryFound(std::uint32_t threadIndex, const std::string &record) = 0;
+  // Called before every directory, after every repository and every few dozen entries whether or not
+  // something was found, so a sink can deliver what it holds on its own schedule. It has to be cheap.
+  virtual void heartbeat() {}
+  // Only a sink returning true gets directoryEntered, the path of every directory costs an allocation.
+  virtual bool wantsDirectories() const { return false; }
+  // Called before a directory is read or replayed from the index, with its path as it is reported.
+  virtual void directoryEntered(std::uint32_t threadIndex, const std::string &path) {}
+};
+
+// What a scan did, once run() returned.
+struct ScanSummary {
+  ScanSummary():
+    firstRepositoryNS(-1),
+    directoriesLeft(0),
+    ioPriorityLowered(false),
+    cpuPriorityLowered(false)
+  {}
+
+  // The counters of every traversal thread, merged.
+  TraversalStats stats;
+  PhaseTimer setupPhase;
+  PhaseTimer traversalPhase;
+  PhaseTimer indexWritePhase;
+  // Since the start of run(), -1 when nothing was found.
+  std::int64_t firstRepositoryNS;
+  std::uint64_t directoriesLeft;
+  // Whether every thread of a background search got its lower priority.
+  bool ioPriorityLowered;
+  bool cpuPriorityLowered;
+};
+
+// Searches directories for repositories with a pool of traversal threads. Has no dependency on Node, the
+// addon and the command line tool both drive it.
+class RepositoryScanner {
+public:
+  // The scan stops early once cancel is set, from any thread.
+  RepositoryScanner(std::vector<std::string> paths, const SearchOptions &searchOptions, ScanSink &sink, std::atomic<bool> &cancel);
+  ~RepositoryScanner();
+
+  // Searches on the calling thread and concurrency - 1 more, and returns once done or cancelled.
+  void run();
+  const ScanSummary &summary() const;
+
+private:
+  class Traversal;
+  std::unique_ptr<Traversal> mTraversal;
+};
+
+#endif
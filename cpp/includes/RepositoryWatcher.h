@@ -0,0 +1,81 @@
+#ifndef REPOSITORY_WATCHER_H
+#define REPOSITORY_WATCHER_H
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "RepositoryScanner.h"
+
+struct RepositoryEvent {
+  enum Type {
+    Added,
+    Removed
+  };
+
+  Type type;
+  std::string path;
+};
+
+// Scans a directory tree once and then keeps the set of repositories in it current with inotify. Every
+// directory that is scanned gets a watch, so a repository appearing or disappearing anywhere under the
+// root only costs a rescan of the directory it changed in. Subtrees that could not get a watch, because the
+// watch cap was reached, are rescanned every poll interval instead. Scans go through RepositoryScanner
+// with the options of the watch, only the first one uses the index.
+class RepositoryWatcher {
+public:
+  typedef std::function<void(std::vector<RepositoryEvent> &events)> EventCallback;
+
+  RepositoryWatcher(
+    std::string rootPath,
+    const SearchOptions &searchOptions,
+    std::uint32_t maxWatches,
+    std::uint32_t pollIntervalMS,
+    EventCallback eventCallback
+  );
+  ~RepositoryWatcher();
+
+  bool start();
+  void stop();
+
+private:
+  class ScanRecorder;
+
+  void run();
+  void handleEvent(std::uint32_t mask, int watchDescriptor, const char *name);
+  void rescanSubtree(const std::string &path);
+  void removeSubtree(const std::string &path);
+  void scanSubtree(const std::string &path, const SearchOptions &searchOptions, std::set<std::string> &repositories);
+  void forgetWatches(const std::string &path, bool includeSelf);
+  bool addWatch(const std::string &path);
+  std::uint32_t depthOf(const std::string &path) const;
+  void emit(RepositoryEvent::Type type, const std::string &path);
+  void flush();
+
+  const std::string mRootPath;
+  const SearchOptions mSearchOptions;
+  // The options of every scan after the first, without the index.
+  SearchOptions mRescanOptions;
+  const std::uint32_t mMaxWatches;
+  const std::uint32_t mPollIntervalMS;
+  EventCallback mEventCallback;
+
+  int mInotifyDescriptor;
+  int mStopDescriptor;
+  std::atomic<bool> mStopping;
+  std::thread mThread;
+
+  // Only touched by the watcher thread.
+  std::map<std::string, int> mWatchesByPath;
+  std::unordered_map<int, std::string> mPathsByWatch;
+  std::set<std::string> mRepositories;
+  std::set<std::string> mUnwatchedSubtrees;
+  std::vector<RepositoryEvent> mPendingEvents;
+};
+
+#endif
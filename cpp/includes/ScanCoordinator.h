@@ -0,0 +1,81 @@
+#ifndef SCAN_COORDINATOR_H
+#define SCAN_COORDINATOR_H
+
+#include <napi.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "RepositoryScanner.h"
+#include "ScanScope.h"
+
+// A caller of findGitRepos waiting on a search, either the one it started or one it joined.
+struct ScanSubscriber {
+  ScanSubscriber(
+    Napi::Function callback,
+    Napi::Promise::Deferred _deferred,
+    const RepositoryFilter &_filter,
+    bool _collectRepositories
+  ):
+    progressCallback(Napi::Persistent(callback)),
+    deferred(_deferred),
+    filter(_filter),
+    collectRepositories(_collectRepositories),
+    cancelled(false)
+  {}
+
+  Napi::FunctionReference progressCallback;
+  Napi::Promise::Deferred deferred;
+  RepositoryFilter filter;
+  bool collectRepositories;
+  bool cancelled;
+  // Found before it joined, handed to it with the next batch.
+  std::string unread;
+  // Only kept when the filter drops some repositories, the others get the ones of the search.
+  std::string repositories;
+  // Set when it joined the search of an outer path, to search its own path instead should that search
+  // report a repository at or above it (see RepositoryFilter::hidesRoot).
+  std::string root;
+  std::unique_ptr<SearchOptions> searchOptions;
+};
+
+// Lets several callers of findGitRepos share one search. Only used on the JS thread.
+struct SharedScan {
+  explicit SharedScan(const ScanScope &_scope):
+    scope(_scope),
+    cacheTTLMS(0)
+  {}
+
+  // Adds a caller to the running search. What was found so far is handed to it with the next batch.
+  void join(std::unique_ptr<ScanSubscriber> subscriber, std::uint32_t subscriberCacheTTLMS);
+  // Removes the callers batch shows the search no longer covers, see RepositoryFilter::hidesRoot.
+  std::vector<std::unique_ptr<ScanSubscriber>> takeUncovered(const std::string &batch);
+  void removeCancelled();
+
+  ScanScope scope;
+  // Everything found so far, for callers joining later and for the cache.
+  std::string repositories;
+  std::vector<std::unique_ptr<ScanSubscriber>> subscribers;
+  // The longest time to live a caller asked for. The results are only cached when it is not 0.
+  std::uint32_t cacheTTLMS;
+};
+
+// The searches of an environment that other callers may join, and the results of recent ones. Only used
+// on the JS thread.
+class ScanCoordinator {
+public:
+  // A running search covering scope, or nullptr. exact is set as by scopeCovers.
+  SharedScan *findRunning(const ScanScope &scope, bool &exact);
+  void add(const std::shared_ptr<SharedScan> &sharedScan);
+  void remove(const SharedScan *sharedScan);
+  // The search is no longer joined. Unless it was cancelled, its results are cached for the callers that
+  // asked.
+  void finish(SharedScan &sharedScan, bool cancelled);
+
+  ScanResultCache cache;
+
+private:
+  std::vector<std::shared_ptr<SharedScan>> mRunningScans;
+};
+
+#endif
@@ -0,0 +1,90 @@
+#ifndef SCAN_INDEX_H
+#define SCAN_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+enum class DirectoryOutcome : std::uint32_t {
+  Descended = 0,
+  Repository = 1,
+  Pruned = 2
+};
+
+struct ScanIndexKey {
+  std::uint64_t device;
+  std::uint64_t inode;
+  std::int64_t mtimeSeconds;
+  std::uint32_t mtimeNanoseconds;
+};
+
+// On disk the index is a header, the records sorted by (device, inode) and a blob holding the NUL
+// terminated names of the subdirectories of every descended directory. Everything is fixed size and
+// native endian so a previous index can be mapped and searched in place.
+struct ScanIndexHeader {
+  char magic[4];
+  std::uint32_t version;
+  std::uint32_t recordSize;
+  std::uint32_t flags;
+  std::uint64_t recordCount;
+  std::uint64_t namesSize;
+};
+
+struct ScanIndexRecord {
+  std::uint64_t device;
+  std::uint64_t inode;
+  std::int64_t mtimeSeconds;
+  std::uint64_t namesOffset;
+  std::uint32_t mtimeNanoseconds;
+  std::uint32_t namesLength;
+  std::uint32_t outcome;
+  std::uint32_t reserved;
+};
+
+// Set by a search that also recognized .git files and bare repositories. Only then do the descended
+// directories of an index hold none, so a search doing the same ignores indexes without the flag.
+static const std::uint32_t kScanIndexClassified = 1;
+
+// A previous index, mapped read-only for the duration of a scan and shared by all traversal threads.
+class ScanIndex {
+public:
+  // An index missing one of requiredFlags, or that fails validation, is treated as empty.
+  ScanIndex(const std::string &indexPath, std::uint32_t requiredFlags);
+  ~ScanIndex();
+
+  // Returns the record of a directory if it is in the index and its mtime did not change since.
+  const ScanIndexRecord *find(const ScanIndexKey &key) const;
+  const char *names(const ScanIndexRecord &record) const;
+
+private:
+  bool isValid(std::uint64_t namesSize) const;
+
+  void *mMapping;
+  size_t mMappingSize;
+  const ScanIndexRecord *mRecords;
+  std::uint64_t mRecordCount;
+  const char *mNames;
+};
+
+// Records the directories visited by one traversal thread. The builders of every thread are merged into
+// a new index once the scan completes.
+class ScanIndexBuilder {
+public:
+  ScanIndexBuilder();
+
+  // Subdirectory names added between begin() and commit() belong to the committed directory. A directory
+  // that is never committed, because it could not be read or the scan was cancelled, leaves no trace.
+  void begin();
+  void addName(const char *name);
+  void commit(const ScanIndexKey &key, DirectoryOutcome outcome);
+  void copy(const ScanIndexRecord &record, const char *names);
+
+  static bool write(const std::string &indexPath, const std::vector<ScanIndexBuilder> &builders, std::uint32_t flags);
+
+private:
+  std::vector<ScanIndexRecord> mRecords;
+  std::string mNames;
+  size_t mCommittedNamesSize;
+};
+
+#endif
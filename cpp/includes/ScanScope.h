@@ -0,0 +1,106 @@
+#ifndef SCAN_SCOPE_H
+#define SCAN_SCOPE_H
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include "PathMatcher.h"
+#include "RepositoryScanner.h"
+
+// What a search with a single root covers, as far as the repositories it reports go. Used to let a search
+// join another one that is running or recently done instead of reading the same directories again.
+struct ScanScope {
+  // As the caller passed it, the paths found are reported below it.
+  std::string root;
+  // root with symlinks, "." and ".." segments and extra slashes resolved, or root itself when it could not
+  // be resolved. Searches are compared by it, so two spellings of one directory share their results.
+  std::string canonicalRoot;
+  // Whether canonicalRoot could be resolved, so the paths found below it name their directories plainly
+  // and no symlink between two nested roots can make them differ.
+  bool canonical;
+  // How repositories are reported. Searches can only share results with the same one.
+  std::string reportKey;
+  bool classify;
+  // Every option changing which repositories are found, reportKey included.
+  std::string optionsKey;
+  // No depth limit, patterns nor mount options, so every repository below root is found.
+  bool unrestricted;
+  // Mount options depend on the file system of the root, so a nested root cannot borrow the results of
+  // an outer one with them.
+  bool mountOptions;
+};
+
+// Describes a search over a single root, for the coordinator to find the searches it can share results with.
+ScanScope makeScanScope(const std::string &root, const SearchOptions &searchOptions);
+
+// Whether the repositories of inner can be taken from a search of outer, which reported outerRepositories
+// so far. Either both search the same directory with the same options, then exact is set and the results
+// only have to be spelled with the root of inner, or inner lies below the canonical root of an unrestricted
+// outer and the results have to be filtered as well. Both go through a RepositoryFilter. A running outer
+// may still report a repository hiding inner, see RepositoryFilter::hidesRoot.
+bool scopeCovers(const ScanScope &outer, const std::string &outerRepositories, const ScanScope &inner, bool &exact);
+
+// Whether the records of a search of source hold a repository at canonicalPath or above it. A search does
+// not go below a repository, so a search reporting one found nothing below canonicalPath, not even what a
+// search of it would report.
+bool reportsRepositoryAtOrAbove(const std::string &records, const ScanScope &source, const std::string &canonicalPath);
+
+// Hands the records of a covering search to a caller the way its own search would have reported them:
+// spelled with its root, and for a nested search only the ones below its root, within its depth limit and
+// not excluded by its patterns. Records are the NUL terminated paths of .git directories, or classified
+// records of kRepositoryInfoFields fields.
+class RepositoryFilter {
+public:
+  // Keeps every record as it is.
+  RepositoryFilter();
+  // exact as set by scopeCovers for source and scope.
+  RepositoryFilter(const ScanScope &source, const ScanScope &scope, bool exact, std::uint32_t maxSubfolderDeep, const PathMatcher &pathMatcher);
+
+  bool keepsAll() const;
+  // Appends the records of batch to keep to filtered.
+  void filter(const std::string &batch, std::string &filtered) const;
+  // Whether batch holds a repository at the root of the nested search or above it, so the covering
+  // search no longer covers it.
+  bool hidesRoot(const std::string &batch) const;
+
+private:
+  bool contains(const std::string &canonicalPath) const;
+  void appendRebased(const char *record, const char *end, std::string &filtered) const;
+
+  bool mKeepAll;
+  bool mExact;
+  std::string mSourceRoot;
+  std::string mSourceCanonicalRoot;
+  std::string mCanonicalRoot;
+  std::string mRoot;
+  std::uint32_t mMaxSubfolderDeep;
+  PathMatcher mPathMatcher;
+  bool mClassify;
+};
+
+// Results of searches done a short while ago. Entries expire after the longest time to live any of their
+// callers asked for, and each lookup only takes entries no older than its own.
+class ScanResultCache {
+public:
+  struct Entry {
+    ScanScope scope;
+    std::shared_ptr<const std::string> repositories;
+    std::chrono::steady_clock::time_point completed;
+    std::chrono::steady_clock::time_point expires;
+  };
+
+  void add(const ScanScope &scope, std::shared_ptr<const std::string> repositories, std::uint32_t timeToLiveMS);
+  // The most recent entry covering scope, or nullptr. exact is set as by scopeCovers.
+  const Entry *find(const ScanScope &scope, std::uint32_t maxAgeMS, bool &exact);
+
+private:
+  static const size_t kMaxEntries = 32;
+
+  void evictExpired();
+
+  std::deque<Entry> mEntries;
+};
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SCAN_STATS_H
+#define SCAN_STATS_H
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+struct SlowDirectory {
+  std::uint64_t latencyNS;
+  std::string path;
+};
+
+// Counters of a single traversal thread. Only the owning thread writes them, so they are plain integers
+// kept on their own cache lines, and they are merged once the traversal is over.
+struct alignas(64) TraversalStats {
+  static const size_t kNumLatencyBuckets = 32;
+  static const size_t kMaxSlowDirectories = 10;
+
+  TraversalStats();
+
+  void recordFailedOpen(int error);
+  void recordFailedRead(int error);
+  bool shouldSampleLatency(std::uint32_t sampleInterval);
+  void recordLatency(std::uint64_t latencyNS);
+  bool isAmongSlowest(std::uint64_t latencyNS) const;
+  void addSlowDirectory(std::uint64_t latencyNS, std::string path);
+  void merge(const TraversalStats &other);
+
+  std::uint64_t directoriesOpened;
+  std::uint64_t directoriesFromIndex;
+  std::uint64_t directoryReads;
+  std::uint64_t entriesRead;
+  std::uint64_t statFallbacks;
+  std::uint64_t repositoriesFound;
+  std::uint64_t duplicateDirectories;
+  std::uint64_t mountsSkipped;
+  std::uint64_t mountsTimedOut;
+  std::uint64_t maxPendingDirectories;
+  std::uint64_t maxFrontierMemoryUsage;
+  std::uint64_t cpuTimeNS;
+  // Time spent waiting for the rate limit of a background search.
+  std::uint64_t throttledNS;
+  std::map<int, std::uint64_t> failedOpens;
+  // Directories that failed partway through their listing, by error.
+  std::map<int, std::uint64_t> failedReads;
+
+  // Latency of every sampleInterval-th directory read by this thread, in power of two microsecond buckets.
+  std::uint64_t latencySamples;
+  std::uint64_t latencyHistogram[kNumLatencyBuckets];
+  std::vector<SlowDirectory> slowestDirectories;
+  std::uint32_t directoriesUntilSample;
+};
+
+// Wall clock and CPU time spent by the calling thread between start() and stop().
+class PhaseTimer {
+public:
+  PhaseTimer();
+
+  void start();
+  void stop();
+
+  std::uint64_t wallTimeNS;
+  std::uint64_t cpuTimeNS;
+
+private:
+  std::uint64_t mWallStartNS;
+  std::uint64_t mCpuStartNS;
+};
+
+std::uint64_t threadCpuTimeNS();
+std::uint64_t wallTimeNS();
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef STAT_BATCH_H
+#define STAT_BATCH_H
+
+#include <string>
+#include <vector>
+
+// Directory entries whose type getdents did not report (DT_UNKNOWN, common on NFS, FUSE and older XFS)
+// are collected per directory and looked up together. With io_uring all lookups of a directory are
+// submitted at once and the kernel runs them concurrently. Without it they are spread over a small
+// thread pool. Either way a high latency mount costs about one round trip per directory instead of one
+// per entry. An entry counts as a directory if it is one and is not a symlink.
+class StatBatch {
+public:
+  void clear();
+  void add(const char *name);
+  size_t size() const;
+  const char *name(size_t index) const;
+  bool isDirectory(size_t index) const;
+
+  void resolve(int directoryDescriptor);
+  // One lookup at a time in the calling thread, for searches whose I/O has to keep the priority of the
+  // thread doing it.
+  void resolveInThisThread(int directoryDescriptor);
+
+private:
+  std::string mNames;
+  std::vector<size_t> mNameOffsets;
+  std::vector<const char *> mNamePointers;
+  std::vector<unsigned char> mIsDirectory;
+};
+
+#endif
@@ -0,0 +1,39 @@
+#ifndef VISITED_SET_H
+#define VISITED_SET_H
+
+#include <cstdint>
+#include <mutex>
+#include <unordered_set>
+
+// Directories already claimed by a search over several roots, keyed by device and inode, so directories
+// reachable from more than one root (nested roots, bind mounts) are read once. The set is split into
+// shards with their own lock, so threads claiming different directories rarely wait on each other.
+class VisitedSet {
+public:
+  // Returns true for the first caller to claim the directory.
+  bool insert(std::uint64_t device, std::uint64_t inode);
+
+private:
+  struct Key {
+    std::uint64_t device;
+    std::uint64_t inode;
+
+    bool operator==(const Key &other) const {
+      return device == other.device && inode == other.inode;
+    }
+  };
+
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+
+  struct alignas(64) Shard {
+    std::mutex mutex;
+    std::unordered_set<Key, KeyHash> keys;
+  };
+
+  static const size_t kNumShards = 64;
+  Shard mShards[kNumShards];
+};
+
+#endif
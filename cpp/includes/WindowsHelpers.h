@@ -78,4 +78,53 @@ static std::wstring convertMultiByteToWideChar(const std::string &multiByte) {
   return wideString;
 }
 
+// The Windows counterpart of a device and inode pair. Reparse points are only followed when asked to.
+static bool getFileId(const std::wstring &path, bool followReparsePoint, std::uint64_t *volume, std::uint64_t *index) {
+  HANDLE handle = CreateFileW(
+    path.c_str(),
+    0,
+    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+    NULL,
+    OPEN_EXISTING,
+    FILE_FLAG_BACKUP_SEMANTICS | (followReparsePoint ? 0 : FILE_FLAG_OPEN_REPARSE_POINT),
+    NULL
+  );
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  BY_HANDLE_FILE_INFORMATION information;
+  const BOOL success = GetFileInformationByHandle(handle, &information);
+  CloseHandle(handle);
+  if (!success) {
+    return false;
+  }
+
+  *volume = information.dwVolumeSerialNumber;
+  *index = ((std::uint64_t)information.nFileIndexHigh << 32) | information.nFileIndexLow;
+  return true;
+}
+
+static bool readSmallFile(const std::wstring &path, std::string *contents, DWORD maxSize) {
+  HANDLE handle = CreateFileW(
+    path.c_str(),
+    GENERIC_READ,
+    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+    NULL,
+    OPEN_EXISTING,
+    FILE_ATTRIBUTE_NORMAL,
+    NULL
+  );
+  if (handle == INVALID_HANDLE_VALUE) {
+    return false;
+  }
+
+  DWORD length = 0;
+  contents->resize(maxSize);
+  const BOOL success = ReadFile(handle, &(*contents)[0], maxSize, &length, NULL);
+  CloseHandle(handle);
+  contents->resize(success ? length : 0);
+  return success == TRUE;
+}
+
 #endif
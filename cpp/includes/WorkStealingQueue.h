@@ -0,0 +1,55 @@
+#ifndef WORK_STEALING_QUEUE_H
+#define WORK_STEALING_QUEUE_H
+
+#include <deque>
+#include <mutex>
+#include "Frontier.h"
+
+// Per-thread deque of pending directories. In breadth-first order the owning thread takes work from the
+// front and idle threads steal from the back. In depth-first order the owning thread takes the newest
+// directory from the back and idle threads steal the oldest from the front, which tend to be the
+// shallowest directories with the most work below them.
+template <typename T>
+class WorkStealingQueue: public Frontier<T> {
+public:
+  void push(T item) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mItems.push_back(std::move(item));
+  }
+
+  bool pop(T &item, bool depthFirst) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (mItems.empty()) {
+      return false;
+    }
+
+    take(item, !depthFirst);
+    return true;
+  }
+
+  bool steal(T &item, bool depthFirst) override {
+    std::unique_lock<std::mutex> lock(mMutex, std::try_to_lock);
+    if (!lock.owns_lock() || mItems.empty()) {
+      return false;
+    }
+
+    take(item, depthFirst);
+    return true;
+  }
+
+private:
+  void take(T &item, bool front) {
+    if (front) {
+      item = std::move(mItems.front());
+      mItems.pop_front();
+    } else {
+      item = std::move(mItems.back());
+      mItems.pop_back();
+    }
+  }
+
+  std::mutex mMutex;
+  std::deque<T> mItems;
+};
+
+#endif
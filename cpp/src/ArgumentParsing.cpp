@@ -0,0 +1,519 @@
+#include "../includes/ArgumentParsing.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <utility>
+
+// NaN and fractions are rejected along with values out of range, so nothing wraps on the way to an integer.
+static bool IsIntegerInRange(const Napi::Value &value, double min, double max) {
+  if (!value.IsNumber()) {
+    return false;
+  }
+
+  const double number = value.ToNumber().DoubleValue();
+  return number >= min && number <= max && std::floor(number) == number;
+}
+
+static bool AddPatterns(const Napi::Value &value, bool exclude, SearchOptions &searchOptions) {
+  if (!value.IsArray()) {
+    return false;
+  }
+
+  Napi::Array patterns = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < patterns.Length(); ++i) {
+    Napi::Value pattern = patterns[i];
+    if (!pattern.IsString()) {
+      return false;
+    }
+
+    const std::string glob = pattern.ToString().Utf8Value();
+    if (!(exclude ? searchOptions.pathMatcher.addExclude(glob) : searchOptions.pathMatcher.addInclude(glob))) {
+      return false;
+    }
+    searchOptions.patterns.push_back((exclude ? "-" : "+") + glob);
+  }
+
+  return true;
+}
+
+static bool AddFileSystemTypes(const Napi::Value &value, std::set<std::string> &fileSystemTypes) {
+  if (!value.IsArray()) {
+    return false;
+  }
+
+  Napi::Array types = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < types.Length(); ++i) {
+    Napi::Value type = types[i];
+    if (!type.IsString() || type.ToString().Utf8Value().empty()) {
+      return false;
+    }
+
+    fileSystemTypes.insert(type.ToString().Utf8Value());
+  }
+
+  return true;
+}
+
+static bool AddMountLimits(const Napi::Value &value, std::map<std::string, MountLimit> &mountLimits) {
+  if (!value.IsObject() || value.IsArray()) {
+    return false;
+  }
+
+  Napi::Object limits = value.ToObject();
+  Napi::Array types = limits.GetPropertyNames();
+  for (uint32_t i = 0; i < types.Length(); ++i) {
+    Napi::Value typeName = types[i];
+    const std::string type = typeName.ToString().Utf8Value();
+    Napi::Value maybeLimit = limits[type];
+    if (!maybeLimit.IsObject()) {
+      return false;
+    }
+
+    Napi::Object limit = maybeLimit.ToObject();
+    MountLimit mountLimit = { 0, 0 };
+    const char *fields[] = { "concurrency", "timeoutMS" };
+    uint32_t *values[] = { &mountLimit.concurrency, &mountLimit.timeoutMS };
+    for (size_t j = 0; j < 2; ++j) {
+      Napi::Value field = limit[fields[j]];
+      if (field.IsUndefined()) {
+        continue;
+      }
+
+      if (!field.IsNumber() || !(field.ToNumber().DoubleValue() >= 1) || field.ToNumber().DoubleValue() > UINT32_MAX) {
+        return false;
+      }
+      *values[j] = field.ToNumber().Uint32Value();
+    }
+
+    mountLimits[type] = mountLimit;
+  }
+
+  return true;
+}
+
+// Either true, or an object with an optional directoriesPerSecond limit and cacheHints.
+static bool ParseBackground(const Napi::Value &value, SearchOptions &searchOptions) {
+  if (value.IsBoolean()) {
+    searchOptions.background = value.As<Napi::Boolean>();
+    return true;
+  }
+
+  if (!value.IsObject() || value.IsArray()) {
+    return false;
+  }
+
+  Napi::Object background = value.ToObject();
+  Napi::Value directoriesPerSecond = background["directoriesPerSecond"];
+  if (!directoriesPerSecond.IsUndefined()) {
+    if (
+      !directoriesPerSecond.IsNumber()
+      || !(directoriesPerSecond.ToNumber().DoubleValue() >= 1)
+      || directoriesPerSecond.ToNumber().DoubleValue() > UINT32_MAX
+    ) {
+      return false;
+    }
+    searchOptions.directoriesPerSecond = directoriesPerSecond.ToNumber().Uint32Value();
+  }
+
+  Napi::Value cacheHints = background["cacheHints"];
+  if (!cacheHints.IsUndefined()) {
+    if (!cacheHints.IsBoolean()) {
+      return false;
+    }
+    searchOptions.cacheHints = cacheHints.As<Napi::Boolean>();
+  }
+
+  searchOptions.background = true;
+  return true;
+}
+
+static bool AddPriorityHints(const Napi::Value &value, DirectoryRanker &ranker) {
+  if (!value.IsArray()) {
+    return false;
+  }
+
+  Napi::Array hints = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < hints.Length(); ++i) {
+    Napi::Value hint = hints[i];
+    if (!hint.IsString() || hint.ToString().Utf8Value().empty()) {
+      return false;
+    }
+
+    ranker.addHint(hint.ToString().Utf8Value());
+  }
+
+  return true;
+}
+
+const napi_type_tag kSnapshotTypeTag = { 0x6a1c0e5b3f7d4e21, 0x9b8e2f4c1d0a7356 };
+
+static bool ParseFileSystem(const Napi::Value &value, SearchOptions &searchOptions) {
+  if (!value.IsObject() || !value.ToObject().CheckTypeTag(&kSnapshotTypeTag)) {
+    return false;
+  }
+
+  void *fileSystem = nullptr;
+  if (napi_unwrap(value.Env(), value, &fileSystem) != napi_ok || !fileSystem) {
+    return false;
+  }
+
+  searchOptions.fileSystem = *static_cast<std::shared_ptr<FileSystemProvider> *>(fileSystem);
+  return true;
+}
+
+std::string ParseSearchOptions(const Napi::Object &options, SearchOptions &searchOptions) {
+  Napi::Value maybeThrottleTimeoutMS = options["throttleTimeoutMS"];
+  if (options.Has("throttleTimeoutMS") && !maybeThrottleTimeoutMS.IsNumber()) {
+    return "options.throttleTimeoutMS must be a number, if passed.";
+  }
+
+  if (maybeThrottleTimeoutMS.IsNumber()) {
+    Napi::Number temp = maybeThrottleTimeoutMS.ToNumber();
+    double bounds = temp.DoubleValue();
+    if (bounds < 0 || bounds > 60000) {
+      return "options.throttleTimeoutMS must be > 0 and <= 60000, if passed.";
+    }
+
+    searchOptions.throttleTimeoutMS = temp;
+  }
+
+  Napi::Value maybeMaxSubfolderDeep = options["maxSubfolderDeep"];
+  if (options.Has("maxSubfolderDeep") && !maybeMaxSubfolderDeep.IsNumber()) {
+    return "options.maxSubfolderDeep must be a number, if passed.";
+  }
+
+  if (maybeMaxSubfolderDeep.IsNumber()) {
+    Napi::Number temp = maybeMaxSubfolderDeep.ToNumber();
+    double bounds = temp.DoubleValue();
+    if (bounds < 1) {
+      return "options.maxSubfolderDeep must be > 0, if passed.";
+    }
+
+    searchOptions.maxSubfolderDeep = temp;
+  }
+
+  Napi::Value maybeConcurrency = options["concurrency"];
+  if (options.Has("concurrency") && !maybeConcurrency.IsNumber()) {
+    return "options.concurrency must be a number, if passed.";
+  }
+
+  if (maybeConcurrency.IsNumber()) {
+    Napi::Number temp = maybeConcurrency.ToNumber();
+    double bounds = temp.DoubleValue();
+    if (bounds < 1 || bounds > 256) {
+      return "options.concurrency must be >= 1 and <= 256, if passed.";
+    }
+
+    searchOptions.concurrency = temp;
+  }
+
+  Napi::Value maybeFrontierMemoryLimitMB = options["frontierMemoryLimitMB"];
+  if (options.Has("frontierMemoryLimitMB") && !maybeFrontierMemoryLimitMB.IsNumber()) {
+    return "options.frontierMemoryLimitMB must be a number, if passed.";
+  }
+
+  if (maybeFrontierMemoryLimitMB.IsNumber()) {
+    double bounds = maybeFrontierMemoryLimitMB.ToNumber().DoubleValue();
+    if (!(bounds > 0)) {
+      return "options.frontierMemoryLimitMB must be > 0, if passed.";
+    }
+
+    searchOptions.frontierMemoryLimit = (size_t)std::min(bounds * 1024 * 1024, (double)(SIZE_MAX / 2));
+  }
+
+  Napi::Value maybeIndexPath = options["indexPath"];
+  if (options.Has("indexPath") && !maybeIndexPath.IsString()) {
+    return "options.indexPath must be a string, if passed.";
+  }
+
+  if (maybeIndexPath.IsString()) {
+    searchOptions.indexPath = maybeIndexPath.ToString().Utf8Value();
+  }
+
+  if (options.Has("exclude") && !AddPatterns(options["exclude"], true, searchOptions)) {
+    return "options.exclude must be an array of non-empty glob patterns, if passed.";
+  }
+
+  if (options.Has("include") && !AddPatterns(options["include"], false, searchOptions)) {
+    return "options.include must be an array of non-empty glob patterns, if passed.";
+  }
+
+  Napi::Value maybeOneFileSystem = options["oneFileSystem"];
+  if (options.Has("oneFileSystem") && !maybeOneFileSystem.IsBoolean()) {
+    return "options.oneFileSystem must be a boolean, if passed.";
+  }
+
+  if (maybeOneFileSystem.IsBoolean()) {
+    searchOptions.oneFileSystem = maybeOneFileSystem.As<Napi::Boolean>();
+  }
+
+  Napi::Value maybeSkipPseudoFileSystems = options["skipPseudoFileSystems"];
+  if (options.Has("skipPseudoFileSystems") && !maybeSkipPseudoFileSystems.IsBoolean()) {
+    return "options.skipPseudoFileSystems must be a boolean, if passed.";
+  }
+
+  if (maybeSkipPseudoFileSystems.IsBoolean()) {
+    searchOptions.skipPseudoFileSystems = maybeSkipPseudoFileSystems.As<Napi::Boolean>();
+  }
+
+  if (options.Has("skipFileSystemTypes") && !AddFileSystemTypes(options["skipFileSystemTypes"], searchOptions.skipFileSystemTypes)) {
+    return "options.skipFileSystemTypes must be an array of non-empty strings, if passed.";
+  }
+
+  if (options.Has("mountLimits") && !AddMountLimits(options["mountLimits"], searchOptions.mountLimits)) {
+    return "options.mountLimits must map file system types to { concurrency, timeoutMS } objects with positive numbers, if passed.";
+  }
+
+  Napi::Value maybeClassify = options["classify"];
+  if (options.Has("classify") && !maybeClassify.IsBoolean()) {
+    return "options.classify must be a boolean, if passed.";
+  }
+
+  if (maybeClassify.IsBoolean()) {
+    searchOptions.classify = maybeClassify.As<Napi::Boolean>();
+  }
+
+  Napi::Value maybeReadHead = options["readHead"];
+  if (options.Has("readHead") && !maybeReadHead.IsBoolean()) {
+    return "options.readHead must be a boolean, if passed.";
+  }
+
+  if (maybeReadHead.IsBoolean()) {
+    searchOptions.readHead = maybeReadHead.As<Napi::Boolean>();
+  }
+
+  Napi::Value maybePrioritize = options["prioritize"];
+  if (options.Has("prioritize") && !maybePrioritize.IsBoolean()) {
+    return "options.prioritize must be a boolean, if passed.";
+  }
+
+  if (maybePrioritize.IsBoolean()) {
+    searchOptions.prioritize = maybePrioritize.As<Napi::Boolean>();
+  }
+
+  if (options.Has("priorityHints")) {
+    if (!AddPriorityHints(options["priorityHints"], searchOptions.ranker)) {
+      return "options.priorityHints must be an array of non-empty strings, if passed.";
+    }
+    searchOptions.prioritize = searchOptions.prioritize || searchOptions.ranker.hasHints();
+  }
+
+  Napi::Value maybeDeadlineMS = options["deadlineMS"];
+  if (
+    options.Has("deadlineMS")
+    && (!maybeDeadlineMS.IsNumber() || !(maybeDeadlineMS.ToNumber().DoubleValue() >= 1) || maybeDeadlineMS.ToNumber().DoubleValue() > UINT32_MAX)
+  ) {
+    return "options.deadlineMS must be a number >= 1, if passed.";
+  }
+
+  if (maybeDeadlineMS.IsNumber()) {
+    searchOptions.deadlineMS = maybeDeadlineMS.ToNumber();
+  }
+
+  Napi::Value maybeMaxDirectories = options["maxDirectories"];
+  if (
+    options.Has("maxDirectories")
+    && (!maybeMaxDirectories.IsNumber() || !(maybeMaxDirectories.ToNumber().DoubleValue() >= 1) || maybeMaxDirectories.ToNumber().DoubleValue() > UINT32_MAX)
+  ) {
+    return "options.maxDirectories must be a number >= 1, if passed.";
+  }
+
+  if (maybeMaxDirectories.IsNumber()) {
+    searchOptions.maxDirectories = maybeMaxDirectories.ToNumber();
+  }
+
+  if (options.Has("background") && !ParseBackground(options["background"], searchOptions)) {
+    return "options.background must be a boolean, or an object with a directoriesPerSecond number >= 1 and a cacheHints boolean, if passed.";
+  }
+
+  if (options.Has("fileSystem") && !ParseFileSystem(options["fileSystem"], searchOptions)) {
+    return "options.fileSystem must be a snapshot from findGitRepos.loadSnapshot, if passed.";
+  }
+
+  return std::string();
+}
+
+bool ParseRoots(const Napi::Value &value, std::vector<std::string> &roots) {
+  if (value.IsString()) {
+    roots.push_back(value.ToString().Utf8Value());
+    return !roots.back().empty();
+  }
+
+  if (!value.IsArray() || value.As<Napi::Array>().Length() == 0) {
+    return false;
+  }
+
+  Napi::Array paths = value.As<Napi::Array>();
+  for (uint32_t i = 0; i < paths.Length(); ++i) {
+    Napi::Value root = paths[i];
+    if (!root.IsString() || root.ToString().Utf8Value().empty()) {
+      return false;
+    }
+    roots.push_back(root.ToString().Utf8Value());
+  }
+
+  return true;
+}
+
+std::string ParseFindOptions(const Napi::Object &options, SearchOptions &searchOptions, FindOptions &findOptions) {
+  const std::string error = ParseSearchOptions(options, searchOptions);
+  if (!error.empty()) {
+    return error;
+  }
+
+  Napi::Value maybeCollectRepositories = options["collectRepositories"];
+  if (options.Has("collectRepositories") && !maybeCollectRepositories.IsBoolean()) {
+    return "options.collectRepositories must be a boolean, if passed.";
+  }
+
+  if (maybeCollectRepositories.IsBoolean()) {
+    findOptions.collectRepositories = maybeCollectRepositories.As<Napi::Boolean>();
+  }
+
+  Napi::Value maybeStats = options["stats"];
+  if (options.Has("stats") && !maybeStats.IsBoolean()) {
+    return "options.stats must be a boolean, if passed.";
+  }
+
+  if (maybeStats.IsBoolean()) {
+    searchOptions.collectStats = maybeStats.As<Napi::Boolean>();
+  }
+
+  // 0 disables sampling.
+  Napi::Value maybeLatencySampleInterval = options["latencySampleInterval"];
+  if (
+    options.Has("latencySampleInterval")
+    && (
+      !maybeLatencySampleInterval.IsNumber()
+      || maybeLatencySampleInterval.ToNumber().DoubleValue() < 0
+      || maybeLatencySampleInterval.ToNumber().DoubleValue() > 1000000
+    )
+  ) {
+    return "options.latencySampleInterval must be a number >= 0 and <= 1000000, if passed.";
+  }
+
+  if (maybeLatencySampleInterval.IsNumber()) {
+    searchOptions.latencySampleInterval = maybeLatencySampleInterval.ToNumber();
+  }
+
+  Napi::Value maybeCoalesce = options["coalesce"];
+  if (options.Has("coalesce") && !maybeCoalesce.IsBoolean()) {
+    return "options.coalesce must be a boolean, if passed.";
+  }
+
+  if (maybeCoalesce.IsBoolean()) {
+    findOptions.coalesce = maybeCoalesce.As<Napi::Boolean>();
+  }
+
+  Napi::Value maybeCacheTTLMS = options["cacheTTLMS"];
+  if (
+    options.Has("cacheTTLMS")
+    && (!maybeCacheTTLMS.IsNumber() || maybeCacheTTLMS.ToNumber().DoubleValue() < 0 || maybeCacheTTLMS.ToNumber().DoubleValue() > 60000)
+  ) {
+    return "options.cacheTTLMS must be a number >= 0 and <= 60000, if passed.";
+  }
+
+  if (maybeCacheTTLMS.IsNumber()) {
+    findOptions.cacheTTLMS = maybeCacheTTLMS.ToNumber();
+  }
+
+  return std::string();
+}
+
+std::string ParseStreamOptions(const Napi::Object &options, SearchOptions &searchOptions, StreamOptions &streamOptions) {
+  const std::string error = ParseSearchOptions(options, searchOptions);
+  if (!error.empty()) {
+    return error;
+  }
+
+  bool hasLowWaterMark = false;
+  Napi::Value maybeHighWaterMark = options["highWaterMark"];
+  if (options.Has("highWaterMark") && !IsIntegerInRange(maybeHighWaterMark, 1, 1000000)) {
+    return "options.highWaterMark must be an integer >= 1 and <= 1000000, if passed.";
+  }
+
+  if (maybeHighWaterMark.IsNumber()) {
+    streamOptions.highWaterMark = maybeHighWaterMark.ToNumber();
+  }
+
+  Napi::Value maybeLowWaterMark = options["lowWaterMark"];
+  if (options.Has("lowWaterMark") && !IsIntegerInRange(maybeLowWaterMark, 0, streamOptions.highWaterMark)) {
+    return "options.lowWaterMark must be an integer >= 0 and <= options.highWaterMark, if passed.";
+  }
+
+  if (maybeLowWaterMark.IsNumber()) {
+    streamOptions.lowWaterMark = maybeLowWaterMark.ToNumber();
+    hasLowWaterMark = true;
+  }
+
+  if (!hasLowWaterMark) {
+    streamOptions.lowWaterMark = streamOptions.highWaterMark / 2;
+  }
+
+  return std::string();
+}
+
+std::string ParseSnapshotOptions(const Napi::Object &options, SimulatedLatency &latency) {
+  const std::pair<const char *, std::uint32_t *> latencies[] = {
+    { "listLatencyUS", &latency.listMicroseconds },
+    { "statLatencyUS", &latency.statMicroseconds },
+    { "readLatencyUS", &latency.readMicroseconds }
+  };
+  for (const auto &option : latencies) {
+    Napi::Value maybeLatency = options[option.first];
+    if (
+      options.Has(option.first)
+      && (!maybeLatency.IsNumber() || !(maybeLatency.ToNumber().DoubleValue() >= 0) || maybeLatency.ToNumber().DoubleValue() > UINT32_MAX)
+    ) {
+      return std::string("options.") + option.first + " must be a number >= 0, if passed.";
+    }
+
+    if (maybeLatency.IsNumber()) {
+      *option.second = maybeLatency.ToNumber();
+    }
+  }
+
+  return std::string();
+}
+
+std::string ParseWatchOptions(const Napi::Object &options, SearchOptions &searchOptions, WatchOptions &watchOptions) {
+  const std::string error = ParseSearchOptions(options, searchOptions);
+  if (!error.empty()) {
+    return error;
+  }
+
+  // Events name .git directories of the disk, and every repository under the root stays watched.
+  if (searchOptions.classify || searchOptions.readHead) {
+    return "options.classify and options.readHead are not supported by findGitRepos.watch.";
+  }
+
+  if (searchOptions.fileSystem) {
+    return "options.fileSystem is not supported by findGitRepos.watch.";
+  }
+
+  if (searchOptions.deadlineMS || searchOptions.maxDirectories) {
+    return "options.deadlineMS and options.maxDirectories are not supported by findGitRepos.watch.";
+  }
+
+  Napi::Value maybeMaxWatches = options["maxWatches"];
+  if (options.Has("maxWatches") && !IsIntegerInRange(maybeMaxWatches, 1, 1000000)) {
+    return "options.maxWatches must be an integer >= 1 and <= 1000000, if passed.";
+  }
+
+  if (maybeMaxWatches.IsNumber()) {
+    watchOptions.maxWatches = maybeMaxWatches.ToNumber();
+  }
+
+  Napi::Value maybePollIntervalMS = options["pollIntervalMS"];
+  // An hour at most, so the interval also fits the int timeout of poll().
+  if (options.Has("pollIntervalMS") && !IsIntegerInRange(maybePollIntervalMS, 0, 3600000)) {
+    return "options.pollIntervalMS must be an integer >= 0 and <= 3600000, if passed.";
+  }
+
+  if (maybePollIntervalMS.IsNumber()) {
+    watchOptions.pollIntervalMS = maybePollIntervalMS.ToNumber();
+  }
+
+  return std::string();
+}
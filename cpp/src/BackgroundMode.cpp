@@ -0,0 +1,81 @@
+#include "../includes/BackgroundMode.h"
+
+#include <algorithm>
+#include <thread>
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(__APPLE__)
+#include <pthread.h>
+#include <sys/qos.h>
+#include <sys/resource.h>
+#endif
+
+namespace {
+  // Cancellation is noticed within this while waiting for a token.
+  const std::chrono::milliseconds kMaxSleep(10);
+
+  #if defined(__linux__)
+  // From linux/ioprio.h, which older kernel headers lack.
+  const int kIoPriorityWhoProcess = 1;
+  const int kIoPriorityClassIdle = 3;
+  const int kIoPriorityClassShift = 13;
+  #endif
+}
+
+ThreadPriority lowerThreadPriority() {
+  ThreadPriority priority = { false, false };
+  #if defined(_WIN32)
+  // Lowers the CPU, I/O and memory priorities of the thread at once.
+  priority.ioLowered = priority.cpuLowered = SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN) != 0;
+  #elif defined(__linux__)
+  // Both are attributes of the calling thread when given 0, not of the whole process.
+  #if defined(SYS_ioprio_set)
+  priority.ioLowered = syscall(SYS_ioprio_set, kIoPriorityWhoProcess, 0, kIoPriorityClassIdle << kIoPriorityClassShift) == 0;
+  #endif
+  struct sched_param schedParam = {};
+  priority.cpuLowered = sched_setscheduler(0, SCHED_IDLE, &schedParam) == 0 || setpriority(PRIO_PROCESS, 0, 19) == 0;
+  #elif defined(__APPLE__)
+  // The background QoS class also throttles the disk I/O of the thread.
+  priority.cpuLowered = pthread_set_qos_class_self_np(QOS_CLASS_BACKGROUND, 0) == 0;
+  priority.ioLowered = setiopolicy_np(IOPOL_TYPE_DISK, IOPOL_SCOPE_THREAD, IOPOL_THROTTLE) == 0 || priority.cpuLowered;
+  #endif
+  return priority;
+}
+
+RateLimiter::RateLimiter(std::uint32_t tokensPerSecond):
+  mTokensPerSecond(tokensPerSecond),
+  mCapacity(std::max(1.0, tokensPerSecond / 10.0)),
+  mTokens(std::max(1.0, tokensPerSecond / 10.0)),
+  mLastRefill(std::chrono::steady_clock::now())
+{}
+
+std::uint64_t RateLimiter::acquire(const std::atomic<bool> &cancel) {
+  std::chrono::steady_clock::time_point due;
+  {
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsedSeconds = std::chrono::duration<double>(now - mLastRefill).count();
+    mTokens = std::min(mCapacity, mTokens + elapsedSeconds * mTokensPerSecond);
+    mLastRefill = now;
+
+    // The token is taken even when it is not there yet, which puts the next callers after this one.
+    mTokens -= 1;
+    if (mTokens >= 0) {
+      return 0;
+    }
+    due = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+      std::chrono::duration<double>(-mTokens / mTokensPerSecond)
+    );
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  for (auto now = start; now < due && !cancel; now = std::chrono::steady_clock::now()) {
+    std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(due - now, kMaxSleep));
+  }
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+}
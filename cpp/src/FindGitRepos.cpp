@@ -1,276 +1,662 @@
 #include <napi.h>
+#include <atomic>
 #include <chrono>
-#include <list>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
 #include <vector>
 #include <algorithm>
+#include <map>
+#include <iterator>
+#include "../includes/ArgumentParsing.h"
+#include "../includes/MemoryFileSystem.h"
 #include "../includes/Queue.h"
-#if defined(_WIN32)
-#include "../includes/WindowsHelpers.h"
-#else
+#include "../includes/RepositoryInfo.h"
+#include "../includes/RepositoryScanner.h"
+#include "../includes/ScanCoordinator.h"
+#include "../includes/ScanScope.h"
+#include "../includes/ScanStats.h"
+#if defined(__linux__)
+#include "../includes/RepositoryWatcher.h"
+#endif
+#if !defined(_WIN32)
 #include <uv.h>
 #endif
 
-class FindGitReposWorker: public Napi::AsyncWorker {
+// Shared by the traversal threads, the progress callbacks and the worker. The thread safe function holds a
+// reference too, so callbacks still queued on the JS thread when the worker is gone find it alive.
+struct ProgressState {
+  ProgressState(size_t numProducers, size_t _highWaterMark, size_t _lowWaterMark):
+    progressQueue(numProducers, kProgressRingInitialCapacity, kProgressRingMaxCapacity),
+    cancel(false),
+    flushPending(false),
+    highWaterMark(_highWaterMark),
+    lowWaterMark(_lowWaterMark),
+    numDelivered(0),
+    paused(false),
+    collectRepositories(true),
+    classify(false),
+    streaming(false),
+    finished(false),
+    numProgressCallbacks(0)
+  {}
+
+  // Every traversal thread gets its own ring, grown as it fills up.
+  static const size_t kProgressRingInitialCapacity = 4 * 1024;
+  static const size_t kProgressRingMaxCapacity = 1024 * 1024;
+  // A progress callback is scheduled once this many repositories are waiting, without waiting for
+  // throttleTimeoutMS, so a burst of them reaches JS in batches of a bounded size.
+  static const size_t kFlushBatchSize = 4096;
+
+  size_t numUndelivered() const {
+    // Read in this order a path can be counted as delivered before it is counted as enqueued, never after.
+    const size_t delivered = numDelivered;
+    const size_t enqueued = progressQueue.numEnqueued();
+    return enqueued > delivered ? enqueued - delivered : 0;
+  }
+
+  RepositoryQueue progressQueue;
+  std::atomic<bool> cancel;
+  std::atomic<bool> flushPending;
+
+  // The search pauses once highWaterMark paths were found that JS did not take yet, and resumes when it
+  // is down to lowWaterMark. A highWaterMark of 0 never pauses.
+  const size_t highWaterMark;
+  const size_t lowWaterMark;
+  std::atomic<size_t> numDelivered;
+  std::atomic<bool> paused;
+  std::mutex resumeMutex;
+  std::condition_variable resumeCondition;
+
+  // Only used on the JS thread.
+  bool collectRepositories;
+  bool classify;
+  bool streaming;
+  bool finished;
+  std::uint64_t numProgressCallbacks;
+  std::string batch;
+  std::string repositories;
+  std::string unread;
+  std::deque<Napi::Promise::Deferred> pendingReads;
+  // Set when other callers may join the search.
+  std::shared_ptr<SharedScan> sharedScan;
+};
+
+// A batch holds NUL terminated paths back to back. One JS string is created for the whole batch and split
+// by the engine, rather than creating a string per path.
+static Napi::Array SplitRepositories(Napi::Env env, const std::string &batch) {
+  if (batch.empty()) {
+    return Napi::Array::New(env, 0);
+  }
+
+  Napi::String joined = Napi::String::New(env, batch.data(), batch.size() - 1);
+  Napi::Function split = joined.ToObject().Get("split").As<Napi::Function>();
+  return split.Call(joined, { Napi::String::New(env, std::string(1, '\0')) }).As<Napi::Array>();
+}
+
+// Classified repositories are records of several NUL terminated fields. The search resolves with objects
+// then, which are built here field by field.
+static Napi::Array RepositoryRecords(Napi::Env env, const std::string &batch) {
+  Napi::Array records = Napi::Array::New(env);
+  const char *field = batch.data();
+  const char *end = batch.data() + batch.size();
+  for (uint32_t i = 0; field < end; ++i) {
+    const char *fields[kRepositoryInfoFields];
+    size_t lengths[kRepositoryInfoFields];
+    for (size_t j = 0; j < kRepositoryInfoFields; ++j) {
+      fields[j] = field;
+      lengths[j] = strlen(field);
+      field += lengths[j] + 1;
+    }
+
+    Napi::Object record = Napi::Object::New(env);
+    record["path"] = Napi::String::New(env, fields[1], lengths[1]);
+    record["kind"] = Napi::String::New(env, repositoryKindName((RepositoryKind)fields[0][0]));
+    record["gitDir"] = Napi::String::New(env, fields[2], lengths[2]);
+    record["branch"] = lengths[3] ? Napi::Value(Napi::String::New(env, fields[3], lengths[3])) : env.Null();
+    records[i] = record;
+  }
+  return records;
+}
+
+static Napi::Array RepositoriesArray(Napi::Env env, bool classify, const std::string &batch) {
+  return classify ? RepositoryRecords(env, batch) : SplitRepositories(env, batch);
+}
+
+static void MarkDelivered(ProgressState *progressState, const std::string &batch) {
+  const size_t numFields = std::count(batch.begin(), batch.end(), '\0');
+  progressState->numDelivered += progressState->classify ? numFields / kRepositoryInfoFields : numFields;
+  if (progressState->paused && progressState->numUndelivered() <= progressState->lowWaterMark) {
+    std::lock_guard<std::mutex> lock(progressState->resumeMutex);
+    progressState->paused = false;
+    progressState->resumeCondition.notify_all();
+  }
+}
+
+// Runs on the JS thread. Every path is kept for the final result, so each one crosses threads only once.
+static Napi::Array DequeueRepositories(Napi::Env env, ProgressState *progressState) {
+  progressState->batch.clear();
+  progressState->progressQueue.dequeueAll(progressState->batch);
+  MarkDelivered(progressState, progressState->batch);
+  if (progressState->collectRepositories) {
+    progressState->repositories += progressState->batch;
+  }
+  return RepositoriesArray(env, progressState->classify, progressState->batch);
+}
+
+static Napi::Object IteratorResult(Napi::Env env, Napi::Value value, bool done) {
+  Napi::Object result = Napi::Object::New(env);
+  result["value"] = value;
+  result["done"] = Napi::Boolean::New(env, done);
+  return result;
+}
+
+// Runs on the JS thread. Everything found since the last read goes to the oldest pending next() call as
+// one batch. Paths nobody asked for yet stay here, counted as undelivered, which is what eventually
+// pauses the search.
+static void FlushStream(Napi::Env env, ProgressState *progressState) {
+  progressState->batch.clear();
+  progressState->progressQueue.dequeueAll(progressState->batch);
+  progressState->unread += progressState->batch;
+  if (progressState->cancel) {
+    progressState->unread.clear();
+  }
+
+  while (!progressState->pendingReads.empty()) {
+    Napi::Promise::Deferred read = progressState->pendingReads.front();
+    if (!progressState->unread.empty()) {
+      MarkDelivered(progressState, progressState->unread);
+      read.Resolve(IteratorResult(env, RepositoriesArray(env, progressState->classify, progressState->unread), false));
+      progressState->unread.clear();
+    } else if (progressState->finished) {
+      read.Resolve(IteratorResult(env, env.Undefined(), true));
+    } else {
+      break;
+    }
+    progressState->pendingReads.pop_front();
+  }
+}
+
+// What a caller sharing a search gets back: the repositories of the search when its filter keeps them all,
+// so they are not kept twice, or the ones it collected.
+static Napi::Array SubscriberRepositories(Napi::Env env, ProgressState *progressState, const ScanSubscriber &subscriber) {
+  if (!subscriber.collectRepositories) {
+    return Napi::Array::New(env, 0);
+  }
+
+  return RepositoriesArray(
+    env,
+    progressState->classify,
+    subscriber.filter.keepsAll() ? progressState->sharedScan->repositories : subscriber.repositories
+  );
+}
+
+static void SearchOnItsOwn(Napi::Env env, std::unique_ptr<ScanSubscriber> subscriber);
+
+// Runs on the JS thread. A caller that joined the search of an outer path is no longer covered by it once
+// it reports a repository at or above the caller's path, and gets a search of its own.
+static void SearchUncoveredSubscribersOnTheirOwn(Napi::Env env, SharedScan &sharedScan, const std::string &batch) {
+  for (auto &subscriber : sharedScan.takeUncovered(batch)) {
+    SearchOnItsOwn(env, std::move(subscriber));
+  }
+}
+
+// Runs on the JS thread. Each caller sharing the search gets the part of the batch it would have found on
+// its own, and is not called when that is nothing. It may cancel on its own: its promise resolves with what
+// it got so far, and the search only stops once no caller is left.
+static void DeliverSharedBatch(Napi::Env env, ProgressState *progressState, const std::string &batch) {
+  SharedScan &sharedScan = *progressState->sharedScan;
+  sharedScan.repositories += batch;
+  SearchUncoveredSubscribersOnTheirOwn(env, sharedScan, batch);
+
+  // A progress callback may start a search joining this one, which then already has the batch.
+  const size_t numSubscribers = sharedScan.subscribers.size();
+  for (size_t i = 0; i < numSubscribers; ++i) {
+    ScanSubscriber &subscriber = *sharedScan.subscribers[i];
+    std::string filtered;
+    filtered.swap(subscriber.unread);
+    subscriber.filter.filter(batch, filtered);
+    if (filtered.empty()) {
+      continue;
+    }
+
+    if (subscriber.collectRepositories && !subscriber.filter.keepsAll()) {
+      subscriber.repositories += filtered;
+    }
+
+    Napi::Value val = subscriber.progressCallback.Call({ RepositoriesArray(env, progressState->classify, filtered) });
+    if (val.IsBoolean() && val.As<Napi::Boolean>()) {
+      subscriber.cancelled = true;
+      subscriber.deferred.Resolve(SubscriberRepositories(env, progressState, subscriber));
+    }
+  }
+
+  sharedScan.removeCancelled();
+  if (sharedScan.subscribers.empty()) {
+    progressState->cancel = true;
+    env.GetInstanceData<ScanCoordinator>()->remove(&sharedScan);
+  }
+}
+
+// Runs on the JS thread once a shared search is done. Every caller left gets the repositories found since
+// the last batch through its progress callback, then its promise resolves, and the search is no longer
+// joined. Unless it was cancelled, its results are cached for the callers that asked.
+static void FinishSharedScan(Napi::Env env, ProgressState *progressState) {
+  SharedScan &sharedScan = *progressState->sharedScan;
+  progressState->batch.clear();
+  progressState->progressQueue.dequeueAll(progressState->batch);
+  if (!progressState->cancel) {
+    DeliverSharedBatch(env, progressState, progressState->batch);
+  }
+
+  for (auto &subscriber : sharedScan.subscribers) {
+    subscriber->deferred.Resolve(SubscriberRepositories(env, progressState, *subscriber));
+  }
+  sharedScan.subscribers.clear();
+  env.GetInstanceData<ScanCoordinator>()->finish(sharedScan, progressState->cancel);
+}
+
+// Runs a RepositoryScanner on a libuv worker thread. The repositories it finds go through the progress
+// state to the progress callback, a stream or the callers sharing the search.
+class FindGitReposWorker: public Napi::AsyncWorker, public ScanSink {
 public:
   FindGitReposWorker(
     Napi::Env env,
-    std::string _path,
-    std::shared_ptr<RepositoryQueue> _progressQueue,
+    Napi::Promise::Deferred _deferred,
+    std::vector<std::string> _paths,
+    std::shared_ptr<ProgressState> _progressState,
+    Napi::Function jsCallback,
     Napi::ThreadSafeFunction _progressCallback,
-    uint32_t _throttleTimeoutMS,
-    uint32_t _maxSubfolderDeep
+    const SearchOptions &searchOptions
   ):
     Napi::AsyncWorker(env),
-    deferred(Napi::Promise::Deferred::New(env)),
-    path(_path),
-    progressQueue(_progressQueue),
+    deferred(_deferred),
+    progressState(_progressState),
+    jsProgressCallback(Napi::Persistent(jsCallback)),
     progressCallback(_progressCallback),
-    throttleTimeoutMS(_throttleTimeoutMS),
-    maxSubfolderDeep(_maxSubfolderDeep),
-    lastProgressCallbackTimePoint(std::chrono::steady_clock::now())
+    throttleTimeoutMS(searchOptions.throttleTimeoutMS),
+    collectStats(searchOptions.collectStats),
+    latencySampleInterval(searchOptions.latencySampleInterval),
+    background(searchOptions.background),
+    lastProgressCallbackTimePoint(std::chrono::steady_clock::now()),
+    numScheduled(0),
+    cancel(_progressState->cancel),
+    scanner(std::move(_paths), searchOptions, *this, _progressState->cancel)
   {
     lastProgressCallbackTimePoint = lastProgressCallbackTimePoint - throttleTimeoutMS;
     cancel = false;
-    prevNumRepos = 0;
   }
 
   ~FindGitReposWorker() {
     progressCallback.Release();
   }
 
-  #if defined(_WIN32)
+  Napi::Promise::Deferred Deferred() const {
+    return deferred;
+  }
+
   void Execute() {
-    const std::wstring gitPath = L".git";
-    const std::wstring dot = L".";
-    const std::wstring dotdot = L"..";
-    std::list<std::wstring> foundPaths;
-    auto rootPath = convertMultiByteToWideChar(path);
-    const bool wasNtPath = isNtPath(rootPath);
-    cancel = false;
+    scanner.run();
+  }
 
-    if (!wasNtPath) {
-      while (!rootPath.empty() && rootPath.back() == L'\\') {
-        rootPath.pop_back();
-      }
-      if (rootPath.empty()) {
+  // Blocks while the consumer is behind by highWaterMark repositories, until it is down to lowWaterMark.
+  void WaitForConsumer() {
+    if (!progressState->highWaterMark) {
+      return;
+    }
+
+    if (!progressState->paused) {
+      if (progressState->numUndelivered() < progressState->highWaterMark) {
         return;
       }
-      rootPath = prefixWithNtPath(rootPath);
+      progressState->paused = true;
     }
 
-    std::uint32_t basePathSubfolderDeep = count(rootPath.begin(), rootPath.end(), L'\\');
-
-    foundPaths.push_back(rootPath);
-
-    while (!cancel && foundPaths.size()) {
-      ThrottledProgressCallback();
+    ScheduleProgressCallback();
+    std::unique_lock<std::mutex> lock(progressState->resumeMutex);
+    while (!cancel && progressState->numUndelivered() > progressState->lowWaterMark) {
+      progressState->resumeCondition.wait_for(lock, std::chrono::milliseconds(10));
+    }
+    progressState->paused = false;
+  }
 
-      WIN32_FIND_DATAW FindFileData;
-      HANDLE hFind = INVALID_HANDLE_VALUE;
-      std::wstring currentPath = foundPaths.front();
-      foundPaths.pop_front();
+  void repositoryFound(std::uint32_t threadIndex, const std::string &record) override {
+    WaitForConsumer();
 
-      std::uint32_t currentSubfolderDeep = count(currentPath.begin(), currentPath.end(), L'\\');
-      if (maxSubfolderDeep > 0 && (currentSubfolderDeep - basePathSubfolderDeep) > maxSubfolderDeep) {
-        break;
+    // A full ring means the JS thread fell behind. It is asked to drain right away, and this thread waits
+    // for room rather than growing the ring.
+    while (!progressState->progressQueue.enqueue(threadIndex, record)) {
+      if (cancel) {
+        return;
       }
 
-      std::wstring wildcardPath = currentPath + L"\\*";
-      hFind = FindFirstFileW(wildcardPath.c_str(), &FindFileData);
-      if (hFind == INVALID_HANDLE_VALUE) {
-        continue;
-      }
+      ScheduleProgressCallback();
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+  }
 
-      std::list<std::wstring> tempPaths;
-      if (
-        (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY
-        && dot != FindFileData.cFileName
-        && dotdot != FindFileData.cFileName
-      ) {
-        if (gitPath == FindFileData.cFileName) {
-          std::string repoPath;
-          int success = convertWideCharToMultiByte(&repoPath, currentPath, wasNtPath);
-          if (!success) {
-            FindClose(hFind);
-            continue;
-          }
-
-          repoPath += "\\.git";
-
-          progressQueue->enqueue(repoPath);
-          repositories.push_back(repoPath);
-          ThrottledProgressCallback();
-          FindClose(hFind);
-          continue;
-        }
+  void heartbeat() override {
+    ThrottledProgressCallback();
+  }
 
-        tempPaths.push_back(currentPath + L"\\" + std::wstring(FindFileData.cFileName));
-      }
 
-      bool isGitRepo = false;
-      while (!cancel && FindNextFileW(hFind, &FindFileData)) {
-        ThrottledProgressCallback();
+  void OnOK() {
+    Napi::Env env = Env();
+    if (progressState->streaming) {
+      progressState->finished = true;
+      FlushStream(env, progressState.get());
+      return;
+    }
 
-        if (dot == FindFileData.cFileName || dotdot == FindFileData.cFileName) {
-          continue;
-        }
+    if (progressState->sharedScan) {
+      FinishSharedScan(env, progressState.get());
+      return;
+    }
 
-        if ((FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != FILE_ATTRIBUTE_DIRECTORY) {
-          continue;
-        }
+    // A progress callback still queued finds the rings empty, so the last repositories are reported here,
+    // before the promise resolves.
+    resultsPhase.start();
+    Napi::Array lastBatch = DequeueRepositories(env, progressState.get());
+    if (!progressState->cancel && !progressState->batch.empty()) {
+      ++progressState->numProgressCallbacks;
+      jsProgressCallback.Call({ lastBatch });
+    }
+    Napi::Array repositoryArray = RepositoriesArray(env, progressState->classify, progressState->repositories);
+    progressState->repositories.clear();
+    resultsPhase.stop();
 
-        if (gitPath == FindFileData.cFileName) {
-          std::string repoPath;
-          int success = convertWideCharToMultiByte(&repoPath, currentPath, wasNtPath);
-          isGitRepo = true;
-          if (!success) {
-            break;
-          }
+    if (!collectStats) {
+      deferred.Resolve(repositoryArray);
+      return;
+    }
 
-          repoPath += "\\.git";
+    Napi::Object result = Napi::Object::New(env);
+    result["repositories"] = repositoryArray;
+    result["stats"] = StatsObject(env);
+    deferred.Resolve(result);
+  }
 
-          progressQueue->enqueue(repoPath);
-          repositories.push_back(repoPath);
-          ThrottledProgressCallback();
-          break;
-        }
+  Napi::Object StatsObject(Napi::Env env) {
+    const ScanSummary &summary = scanner.summary();
+    const TraversalStats &stats = summary.stats;
 
-        tempPaths.push_back(currentPath + L"\\" + std::wstring(FindFileData.cFileName));
-        ThrottledProgressCallback();
-      }
+    auto milliseconds = [env](std::uint64_t nanoseconds) {
+      return Napi::Number::New(env, nanoseconds / 1e6);
+    };
+    auto phase = [env, &milliseconds](std::uint64_t wallTimeNS, std::uint64_t cpuTimeNS) {
+      Napi::Object phaseObject = Napi::Object::New(env);
+      phaseObject["wallMS"] = milliseconds(wallTimeNS);
+      phaseObject["cpuMS"] = milliseconds(cpuTimeNS);
+      return phaseObject;
+    };
 
-      if (!isGitRepo) {
-        foundPaths.splice(foundPaths.end(), tempPaths);
+    auto errorCounts = [env](const std::map<int, std::uint64_t> &errors) {
+      Napi::Object counts = Napi::Object::New(env);
+      for (const auto &error : errors) {
+        #if defined(_WIN32)
+        counts[std::to_string(error.first)] = Napi::Number::New(env, (double)error.second);
+        #else
+        counts[uv_err_name(-error.first)] = Napi::Number::New(env, (double)error.second);
+        #endif
       }
+      return counts;
+    };
 
-      FindClose(hFind);
-    }
-  }
-  #else
-  void Execute() {
-    uv_dirent_t directoryEntry;
-    uv_fs_t scandirRequest;
-    std::list<std::string> foundPaths;
-    foundPaths.push_back(path);
-    std::uint32_t basePathSubfolderDeep = count(path.begin(), path.end(), '/');
-    cancel = false;
-
-    while (!cancel && foundPaths.size()) {
-      ThrottledProgressCallback();
-  
-      std::list<std::string> temp;
-      bool isGitRepo = false;
-      std::string currentPath = foundPaths.front();
-      foundPaths.pop_front();
-
-      std::uint32_t currentSubfolderDeep = count(currentPath.begin(), currentPath.end(), '/');
-      if (maxSubfolderDeep > 0 && (currentSubfolderDeep - basePathSubfolderDeep) > maxSubfolderDeep) {
-        break;
-      }
+    Napi::Object phases = Napi::Object::New(env);
+    phases["setup"] = phase(summary.setupPhase.wallTimeNS, summary.setupPhase.cpuTimeNS);
+    // Every traversal thread measures its own CPU time.
+    phases["traversal"] = phase(summary.traversalPhase.wallTimeNS, stats.cpuTimeNS);
+    phases["indexWrite"] = phase(summary.indexWritePhase.wallTimeNS, summary.indexWritePhase.cpuTimeNS);
+    phases["results"] = phase(resultsPhase.wallTimeNS, resultsPhase.cpuTimeNS);
 
-      if (uv_fs_scandir(NULL, &scandirRequest, (currentPath + '/').c_str(), 0, NULL) < 0) {
-        continue;
-      }
+    Napi::Object statsObject = Napi::Object::New(env);
+    statsObject["directoriesOpened"] = Napi::Number::New(env, (double)stats.directoriesOpened);
+    statsObject["directoriesFromIndex"] = Napi::Number::New(env, (double)stats.directoriesFromIndex);
+    statsObject["directoryReads"] = Napi::Number::New(env, (double)stats.directoryReads);
+    statsObject["entriesRead"] = Napi::Number::New(env, (double)stats.entriesRead);
+    statsObject["statFallbacks"] = Napi::Number::New(env, (double)stats.statFallbacks);
+    statsObject["failedOpens"] = errorCounts(stats.failedOpens);
+    statsObject["failedReads"] = errorCounts(stats.failedReads);
+    statsObject["maxPendingDirectories"] = Napi::Number::New(env, (double)stats.maxPendingDirectories);
+    statsObject["maxPendingDirectoriesBytes"] = Napi::Number::New(env, (double)stats.maxFrontierMemoryUsage);
+    statsObject["repositoriesFound"] = Napi::Number::New(env, (double)stats.repositoriesFound);
+    statsObject["duplicateDirectories"] = Napi::Number::New(env, (double)stats.duplicateDirectories);
+    statsObject["mountsSkipped"] = Napi::Number::New(env, (double)stats.mountsSkipped);
+    statsObject["mountsTimedOut"] = Napi::Number::New(env, (double)stats.mountsTimedOut);
+    statsObject["directoriesLeft"] = Napi::Number::New(env, (double)summary.directoriesLeft);
+    statsObject["progressCallbacks"] = Napi::Number::New(env, (double)progressState->numProgressCallbacks);
+    statsObject["timeToFirstRepositoryMS"] = summary.firstRepositoryNS < 0
+      ? env.Null()
+      : Napi::Value(milliseconds((std::uint64_t)summary.firstRepositoryNS));
+    statsObject["phases"] = phases;
 
-      while (!cancel && uv_fs_scandir_next(&scandirRequest, &directoryEntry) != UV_EOF) {
-        std::string nextPath = currentPath + '/' + directoryEntry.name;
-        ThrottledProgressCallback();
-
-        if (directoryEntry.type == UV_DIRENT_UNKNOWN) {
-          uv_fs_t lstatRequest;
-          if (
-            uv_fs_lstat(NULL, &lstatRequest, nextPath.c_str(), NULL) < 0
-            || !S_ISDIR(lstatRequest.statbuf.st_mode)
-            || S_ISLNK(lstatRequest.statbuf.st_mode)
-          ) {
-            continue;
-          }
-        } else if (directoryEntry.type != UV_DIRENT_DIR) {
-          continue;
-        }
+    // The rates the search actually ran at, to tune directoriesPerSecond against.
+    if (background) {
+      const double traversalSeconds = summary.traversalPhase.wallTimeNS / 1e9;
+      const double directoriesRead = (double)(stats.directoriesOpened + stats.directoriesFromIndex);
+      Napi::Object backgroundObject = Napi::Object::New(env);
+      backgroundObject["ioPriorityLowered"] = Napi::Boolean::New(env, summary.ioPriorityLowered);
+      backgroundObject["cpuPriorityLowered"] = Napi::Boolean::New(env, summary.cpuPriorityLowered);
+      backgroundObject["directoriesPerSecond"] = Napi::Number::New(env, traversalSeconds > 0 ? directoriesRead / traversalSeconds : 0);
+      backgroundObject["entriesPerSecond"] = Napi::Number::New(env, traversalSeconds > 0 ? stats.entriesRead / traversalSeconds : 0);
+      backgroundObject["throttledMS"] = milliseconds(stats.throttledNS);
+      statsObject["background"] = backgroundObject;
+    }
 
-        if (strcmp(directoryEntry.name, ".git")) {
-          temp.push_back(nextPath);
+    if (latencySampleInterval) {
+      Napi::Array histogram = Napi::Array::New(env);
+      for (size_t i = 0; i < TraversalStats::kNumLatencyBuckets; ++i) {
+        if (!stats.latencyHistogram[i]) {
           continue;
         }
 
-        isGitRepo = true;
-        progressQueue->enqueue(nextPath);
-        repositories.push_back(nextPath);
-        ThrottledProgressCallback();
+        Napi::Object bucket = Napi::Object::New(env);
+        bucket["maxMicroseconds"] = Napi::Number::New(env, (double)(std::uint64_t(2) << i));
+        bucket["count"] = Napi::Number::New(env, (double)stats.latencyHistogram[i]);
+        histogram[histogram.Length()] = bucket;
       }
 
-      if (!isGitRepo) {
-        foundPaths.splice(foundPaths.end(), temp);
+      Napi::Array slowestDirectories = Napi::Array::New(env, stats.slowestDirectories.size());
+      for (size_t i = 0; i < stats.slowestDirectories.size(); ++i) {
+        Napi::Object directory = Napi::Object::New(env);
+        directory["path"] = Napi::String::New(env, stats.slowestDirectories[i].path);
+        directory["latencyMS"] = milliseconds(stats.slowestDirectories[i].latencyNS);
+        slowestDirectories[(uint32_t)i] = directory;
       }
-    }
-  }
-  #endif
 
-  void OnOK() {
-    Napi::Env env = Env();
-    size_t numRepos = repositories.size();
-    Napi::Array repositoryArray = Napi::Array::New(env, numRepos);
-    for (size_t i = 0; i < numRepos; ++i) {
-      repositoryArray[i] = Napi::String::New(env, repositories[i]);
+      Napi::Object latency = Napi::Object::New(env);
+      latency["samples"] = Napi::Number::New(env, (double)stats.latencySamples);
+      latency["histogram"] = histogram;
+      latency["slowestDirectories"] = slowestDirectories;
+      statsObject["latency"] = latency;
     }
 
-    deferred.Resolve(repositoryArray);
+    return statsObject;
   }
 
   Napi::Promise Promise() {
     return deferred.Promise();
   }
 
-  void ThrottledProgressCallback() {
-    auto callback = [&cancel = cancel](Napi::Env env, Napi::Function jsCallback, RepositoryQueue *progressQueue) {
-      int numRepos = progressQueue->count();
+  static void CallProgressCallback(Napi::Env env, Napi::Function jsCallback, ProgressState *progressState) {
+    progressState->flushPending = false;
+    if (progressState->streaming) {
+      FlushStream(env, progressState);
+      return;
+    }
 
-      Napi::Array repositoryArray = Napi::Array::New(env, numRepos);
-      for (int i = 0; i < numRepos; ++i) {
-        // TODO upgrade progressQueue to be type safe here
-        repositoryArray[(uint32_t)i] = Napi::String::New(env, progressQueue->dequeue());
-      }
+    if (progressState->sharedScan) {
+      progressState->batch.clear();
+      progressState->progressQueue.dequeueAll(progressState->batch);
+      MarkDelivered(progressState, progressState->batch);
+      ++progressState->numProgressCallbacks;
+      DeliverSharedBatch(env, progressState, progressState->batch);
+      return;
+    }
 
-      Napi::Value val = jsCallback.Call({ repositoryArray });
-      if (val.IsBoolean() && val.As<Napi::Boolean>()) {
-        cancel = true;
-      }
-    };
+    // The call before this one may have taken what it was scheduled for.
+    Napi::Array repositoryArray = DequeueRepositories(env, progressState);
+    if (progressState->batch.empty()) {
+      return;
+    }
+
+    ++progressState->numProgressCallbacks;
+    Napi::Value val = jsCallback.Call({ repositoryArray });
+    if (val.IsBoolean() && val.As<Napi::Boolean>()) {
+      progressState->cancel = true;
+    }
+  }
+
+  void ScheduleProgressCallback() {
+    // Every call takes everything found so far, so one queued call is always enough. What is found while
+    // it waits for the JS thread goes with the next one, rather than flooding the event loop with calls.
+    if (progressState->flushPending.exchange(true)) {
+      return;
+    }
+
+    numScheduled = progressState->progressQueue.numEnqueued();
+    progressCallback.NonBlockingCall(progressState.get(), CallProgressCallback);
+  }
+
+  // Flushes once throttleTimeoutMS passed since the last flush or kFlushBatchSize repositories are waiting,
+  // whichever comes first. The clock is only read when something new is waiting and no call is queued.
+  void ThrottledProgressCallback() {
+    if (progressState->flushPending.load(std::memory_order_relaxed)) {
+      return;
+    }
 
-    if (throttleTimeoutMS.count() == 0 && prevNumRepos != progressQueue->count()) {
-      progressCallback.NonBlockingCall(progressQueue.get(), callback);
-      prevNumRepos = progressQueue->count();
+    const size_t numWaiting = progressState->progressQueue.numEnqueued() - numScheduled.load(std::memory_order_relaxed);
+    if (numWaiting == 0) {
       return;
     }
 
-    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
-    if (now - lastProgressCallbackTimePoint < throttleTimeoutMS) {
+    // Several traversal threads may get here at once, only one of them needs to schedule the callback.
+    std::unique_lock<std::mutex> lock(progressMutex, std::try_to_lock);
+    if (!lock.owns_lock()) {
       return;
     }
 
-    progressCallback.NonBlockingCall(progressQueue.get(), callback);
+    const std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (numWaiting < ProgressState::kFlushBatchSize && now - lastProgressCallbackTimePoint < throttleTimeoutMS) {
+      return;
+    }
+
+    ScheduleProgressCallback();
     lastProgressCallbackTimePoint = now;
   }
 
 private:
   Napi::Promise::Deferred deferred;
-  std::string path;
-  std::shared_ptr<RepositoryQueue> progressQueue;
+  std::shared_ptr<ProgressState> progressState;
+  // Called directly once the search is done, with what the thread safe function did not deliver.
+  Napi::FunctionReference jsProgressCallback;
   Napi::ThreadSafeFunction progressCallback;
   std::chrono::milliseconds throttleTimeoutMS;
-  std::uint32_t maxSubfolderDeep;
+  bool collectStats;
+  std::uint32_t latencySampleInterval;
+  const bool background;
+  PhaseTimer resultsPhase;
   std::chrono::steady_clock::time_point lastProgressCallbackTimePoint;
-  std::vector<std::string> repositories;
-  bool cancel;
-  int prevNumRepos; // Used to determine if we should throttle if throttleTimeoutMS is 0
+  std::mutex progressMutex;
+  // Repositories found when the last callback was scheduled, the ones after it are waiting.
+  std::atomic<size_t> numScheduled;
+  std::atomic<bool> &cancel;
+  RepositoryScanner scanner;
+};
+
+static FindGitReposWorker *NewSearchWorker(
+  Napi::Env env,
+  Napi::Promise::Deferred deferred,
+  const std::vector<std::string> &roots,
+  std::shared_ptr<ProgressState> progressState,
+  Napi::Function callback,
+  const SearchOptions &searchOptions,
+  bool collectRepositories
+) {
+  progressState->collectRepositories = collectRepositories;
+  progressState->classify = searchOptions.classify;
+  Napi::ThreadSafeFunction progressCallback = Napi::ThreadSafeFunction::New(
+    env,
+    callback,
+    "findGitRepos",
+    0,
+    1,
+    [progressState](Napi::Env env) {}
+  );
+
+  return new FindGitReposWorker(env, deferred, roots, progressState, callback, progressCallback, searchOptions);
+}
+
+// Runs on the JS thread, for a caller the search it joined turned out not to cover. Its promise is resolved
+// by a search of its own path, which is not shared.
+static void SearchOnItsOwn(Napi::Env env, std::unique_ptr<ScanSubscriber> subscriber) {
+  std::shared_ptr<ProgressState> progressState(new ProgressState(subscriber->searchOptions->concurrency, 0, 0));
+  FindGitReposWorker *worker = NewSearchWorker(
+    env,
+    subscriber->deferred,
+    std::vector<std::string>(1, subscriber->root),
+    progressState,
+    subscriber->progressCallback.Value(),
+    *subscriber->searchOptions,
+    subscriber->collectRepositories
+  );
+  worker->Queue();
+}
+
+// Answers a search from the results of a recent one. The results are filtered off the JS thread, then
+// handed to the progress callback at once, as a search finding them all in one batch would.
+class CachedScanWorker: public Napi::AsyncWorker {
+public:
+  CachedScanWorker(
+    Napi::Env env,
+    Napi::Function callback,
+    std::shared_ptr<const std::string> _repositories,
+    const RepositoryFilter &_filter,
+    bool _classify,
+    bool _collectRepositories
+  ):
+    Napi::AsyncWorker(env),
+    deferred(Napi::Promise::Deferred::New(env)),
+    progressCallback(Napi::Persistent(callback)),
+    repositories(_repositories),
+    filter(_filter),
+    classify(_classify),
+    collectRepositories(_collectRepositories)
+  {}
+
+  void Execute() {
+    filter.filter(*repositories, filtered);
+  }
+
+  void OnOK() {
+    Napi::Env env = Env();
+    if (!filtered.empty()) {
+      progressCallback.Call({ RepositoriesArray(env, classify, filtered) });
+    }
+    deferred.Resolve(collectRepositories ? RepositoriesArray(env, classify, filtered) : Napi::Array::New(env, 0));
+  }
+
+  Napi::Promise Promise() {
+    return deferred.Promise();
+  }
+
+private:
+  Napi::Promise::Deferred deferred;
+  Napi::FunctionReference progressCallback;
+  std::shared_ptr<const std::string> repositories;
+  const RepositoryFilter filter;
+  const bool classify;
+  const bool collectRepositories;
+  std::string filtered;
 };
 
 Napi::Promise FindGitRepos(const Napi::CallbackInfo& info) {
   Napi::Env env = info.Env();
-  if (info.Length() < 1 || !info[0].IsString() || info[0].ToString().Utf8Value().empty()) {
+  std::vector<std::string> roots;
+  if (info.Length() < 1 || !ParseRoots(info[0], roots)) {
     Napi::Promise::Deferred deferred(env);
-    deferred.Reject(Napi::TypeError::New(env, "Must provide non-empty starting path as first argument.").Value());
+    deferred.Reject(Napi::TypeError::New(env, "Must provide a non-empty starting path, or an array of them, as first argument.").Value());
     return deferred.Promise();
   }
 
@@ -280,76 +666,429 @@ Napi::Promise FindGitRepos(const Napi::CallbackInfo& info) {
     return deferred.Promise();
   }
 
-  uint32_t throttleTimeoutMS = 0;
-  uint32_t maxSubfolderDeep = 0;
-
+  SearchOptions searchOptions;
+  FindOptions findOptions;
   if (info.Length() >= 3) {
     if (!info[2].IsObject()) {
       Napi::Promise::Deferred deferred(env);
       deferred.Reject(Napi::TypeError::New(env, "Options argument must be an object, if passed.").Value());
       return deferred.Promise();
-
     }
 
     Napi::Object options = info[2].ToObject();
-    Napi::Value maybeThrottleTimeoutMS = options["throttleTimeoutMS"];
-    if (options.Has("throttleTimeoutMS") && !maybeThrottleTimeoutMS.IsNumber()) {
+    const std::string error = ParseFindOptions(options, searchOptions, findOptions);
+    if (!error.empty()) {
       Napi::Promise::Deferred deferred(env);
-      deferred.Reject(Napi::TypeError::New(env, "options.throttleTimeoutMS must be a number, if passed.").Value());
+      deferred.Reject(Napi::TypeError::New(env, error).Value());
       return deferred.Promise();
     }
+  }
 
-    if (maybeThrottleTimeoutMS.IsNumber()) {
-      Napi::Number temp = maybeThrottleTimeoutMS.ToNumber();
-      double bounds = temp.DoubleValue();
-      if (bounds < 0 || bounds > 60000) {
-        Napi::Promise::Deferred deferred(env);
-        deferred.Reject(Napi::TypeError::New(env, "options.throttleTimeoutMS must be > 0 and <= 60000, if passed.").Value());
-        return deferred.Promise();
-      }
+  // A search asking for statistics measures a traversal of its own, one with a budget only finds part of
+  // the repositories, one in the background would hold back the searches joining it, one of a snapshot
+  // does not see the disk, and only searches of a single root are shared. A search covered by a recent one is
+  // answered from its results, and one covered by a running search joins it, unless it has an index of its
+  // own to update.
+  ScanCoordinator *coordinator = env.GetInstanceData<ScanCoordinator>();
+  const bool shareable = roots.size() == 1
+    && !searchOptions.collectStats
+    && !searchOptions.deadlineMS
+    && !searchOptions.maxDirectories
+    && !searchOptions.background
+    && !searchOptions.fileSystem;
+  ScanScope scope;
+  if (shareable) {
+    scope = makeScanScope(roots[0], searchOptions);
+    bool exact = false;
+    auto filterFor = [&](const ScanScope &source) {
+      return RepositoryFilter(source, scope, exact, searchOptions.maxSubfolderDeep, searchOptions.pathMatcher);
+    };
 
-      throttleTimeoutMS = temp;
+    const ScanResultCache::Entry *cached = findOptions.cacheTTLMS ? coordinator->cache.find(scope, findOptions.cacheTTLMS, exact) : nullptr;
+    if (cached) {
+      CachedScanWorker *worker = new CachedScanWorker(
+        env,
+        info[1].As<Napi::Function>(),
+        cached->repositories,
+        filterFor(cached->scope),
+        searchOptions.classify,
+        findOptions.collectRepositories
+      );
+      worker->Queue();
+      return worker->Promise();
     }
 
-    Napi::Value maybeMaxSubfolderDeep = options["maxSubfolderDeep"];
-    if (options.Has("maxSubfolderDeep") && !maybeMaxSubfolderDeep.IsNumber()) {
-      Napi::Promise::Deferred deferred(env);
-      deferred.Reject(Napi::TypeError::New(env, "options.maxSubfolderDeep must be a number, if passed.").Value());
+    SharedScan *running = findOptions.coalesce && searchOptions.indexPath.empty() ? coordinator->findRunning(scope, exact) : nullptr;
+    if (running) {
+      Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+      std::unique_ptr<ScanSubscriber> subscriber(new ScanSubscriber(info[1].As<Napi::Function>(), deferred, filterFor(running->scope), findOptions.collectRepositories));
+      if (!exact) {
+        subscriber->root = roots[0];
+        subscriber->searchOptions.reset(new SearchOptions(searchOptions));
+      }
+      running->join(std::move(subscriber), findOptions.cacheTTLMS);
       return deferred.Promise();
     }
+  }
 
-    if (maybeMaxSubfolderDeep.IsNumber()) {
-      Napi::Number temp = maybeMaxSubfolderDeep.ToNumber();
-      double bounds = temp.DoubleValue();
-      if (bounds < 1) {
-        Napi::Promise::Deferred deferred(env);
-        deferred.Reject(Napi::TypeError::New(env, "options.maxSubfolderDeep must be > 0, if passed.").Value());
-        return deferred.Promise();
-      }
+  std::shared_ptr<ProgressState> progressState(new ProgressState(searchOptions.concurrency, 0, 0));
+  FindGitReposWorker *worker = NewSearchWorker(
+    env,
+    Napi::Promise::Deferred::New(env),
+    roots,
+    progressState,
+    info[1].As<Napi::Function>(),
+    searchOptions,
+    findOptions.collectRepositories
+  );
+
+  // Callers joining later need every repository found so far, which a search not collecting them lacks.
+  if (shareable && findOptions.collectRepositories) {
+    progressState->sharedScan.reset(new SharedScan(scope));
+    progressState->sharedScan->cacheTTLMS = findOptions.cacheTTLMS;
+    progressState->sharedScan->subscribers.emplace_back(new ScanSubscriber(info[1].As<Napi::Function>(), worker->Deferred(), RepositoryFilter(), true));
+    coordinator->add(progressState->sharedScan);
+  }
+  worker->Queue();
+
+  return worker->Promise();
+}
 
-      maxSubfolderDeep = temp;
+// Shared by the functions of a stream, so each of them keeps working when detached from the iterator.
+// Once all of them are garbage collected nobody can read the rest of the search, so it is cancelled
+// rather than left paused at the high water mark.
+struct StreamHandle {
+  explicit StreamHandle(std::shared_ptr<ProgressState> _progressState):
+    progressState(_progressState)
+  {}
+
+  ~StreamHandle() {
+    progressState->cancel = true;
+  }
+
+  std::shared_ptr<ProgressState> progressState;
+};
+
+static Napi::Function NewStreamFunction(
+  Napi::Env env,
+  Napi::Value (*callback)(const Napi::CallbackInfo &info),
+  const char *name,
+  const std::shared_ptr<StreamHandle> &streamHandle
+) {
+  std::shared_ptr<StreamHandle> *data = new std::shared_ptr<StreamHandle>(streamHandle);
+  Napi::Function function = Napi::Function::New(env, callback, name, data);
+  function.AddFinalizer([](Napi::Env env, std::shared_ptr<StreamHandle> *data) {
+    delete data;
+  }, data);
+  return function;
+}
+
+static Napi::Value ReadStream(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  ProgressState *progressState = (*static_cast<std::shared_ptr<StreamHandle> *>(info.Data()))->progressState.get();
+  Napi::Promise::Deferred read = Napi::Promise::Deferred::New(env);
+  progressState->pendingReads.push_back(read);
+  FlushStream(env, progressState);
+  return read.Promise();
+}
+
+// Called when a for await loop is left early. The search is cancelled and every pending read ends.
+static Napi::Value ReturnStream(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  ProgressState *progressState = (*static_cast<std::shared_ptr<StreamHandle> *>(info.Data()))->progressState.get();
+  progressState->cancel = true;
+  progressState->finished = true;
+  {
+    std::lock_guard<std::mutex> lock(progressState->resumeMutex);
+    progressState->resumeCondition.notify_all();
+  }
+  FlushStream(env, progressState);
+
+  Napi::Promise::Deferred deferred = Napi::Promise::Deferred::New(env);
+  deferred.Resolve(IteratorResult(env, env.Undefined(), true));
+  return deferred.Promise();
+}
+
+Napi::Value StreamGitRepos(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  std::vector<std::string> roots;
+  if (info.Length() < 1 || !ParseRoots(info[0], roots)) {
+    Napi::TypeError::New(env, "Must provide a non-empty starting path, or an array of them, as first argument.").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  SearchOptions searchOptions;
+  StreamOptions streamOptions;
+  if (info.Length() >= 2) {
+    if (!info[1].IsObject()) {
+      Napi::TypeError::New(env, "Options argument must be an object, if passed.").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    Napi::Object options = info[1].ToObject();
+    const std::string error = ParseStreamOptions(options, searchOptions, streamOptions);
+    if (!error.empty()) {
+      Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+      return env.Undefined();
     }
   }
 
-  std::shared_ptr<RepositoryQueue> progressQueue(new RepositoryQueue);
+  std::shared_ptr<ProgressState> progressState(
+    new ProgressState(searchOptions.concurrency, streamOptions.highWaterMark, streamOptions.lowWaterMark)
+  );
+  progressState->streaming = true;
+  progressState->collectRepositories = false;
+  progressState->classify = searchOptions.classify;
+
+  // Batches are handed to next() calls, the function given to the thread safe function is never called.
+  Napi::Function noop = Napi::Function::New(env, [](const Napi::CallbackInfo& info) {});
   Napi::ThreadSafeFunction progressCallback = Napi::ThreadSafeFunction::New(
     env,
-    info[1].As<Napi::Function>(),
-    "findGitRepos",
+    noop,
+    "findGitRepos.stream",
     0,
     1,
-    [progressQueue](Napi::Env env) {}
+    [progressState](Napi::Env env) {}
   );
 
-  FindGitReposWorker *worker = new FindGitReposWorker(info.Env(), info[0].ToString(), progressQueue, progressCallback, throttleTimeoutMS, maxSubfolderDeep);
+  FindGitReposWorker *worker = new FindGitReposWorker(
+    env,
+    Napi::Promise::Deferred::New(env),
+    roots,
+    progressState,
+    noop,
+    progressCallback,
+    searchOptions
+  );
   worker->Queue();
 
+  std::shared_ptr<StreamHandle> streamHandle(new StreamHandle(progressState));
+  Napi::Object stream = Napi::Object::New(env);
+  stream["next"] = NewStreamFunction(env, ReadStream, "next", streamHandle);
+  stream["return"] = NewStreamFunction(env, ReturnStream, "return", streamHandle);
+  stream.Set(
+    Napi::Symbol::WellKnown(env, "asyncIterator"),
+    Napi::Function::New(env, [](const Napi::CallbackInfo& info) -> Napi::Value { return info.This(); }, "[Symbol.asyncIterator]")
+  );
+  return stream;
+}
+
+// Loads a snapshot off the JS thread. It is wrapped in the object the promise resolves to, and freed once
+// that object and every search using it are gone.
+class LoadSnapshotWorker: public Napi::AsyncWorker {
+public:
+  LoadSnapshotWorker(Napi::Env env, const std::string &_snapshotPath, const SimulatedLatency &latency):
+    Napi::AsyncWorker(env),
+    deferred(Napi::Promise::Deferred::New(env)),
+    snapshotPath(_snapshotPath),
+    fileSystem(new MemoryFileSystem(latency))
+  {}
+
+  void Execute() {
+    std::string error;
+    if (!fileSystem->load(snapshotPath, error)) {
+      SetError("Could not load the snapshot: " + error);
+    }
+  }
+
+  void OnOK() {
+    Napi::Env env = Env();
+    Napi::Object snapshot = Napi::Object::New(env);
+    snapshot["path"] = Napi::String::New(env, snapshotPath);
+    snapshot["entries"] = Napi::Number::New(env, (double)fileSystem->numEntries());
+    snapshot.TypeTag(&kSnapshotTypeTag);
+
+    std::shared_ptr<FileSystemProvider> *data = new std::shared_ptr<FileSystemProvider>(fileSystem);
+    napi_wrap(env, snapshot, data, [](napi_env env, void *data, void *hint) {
+      delete static_cast<std::shared_ptr<FileSystemProvider> *>(data);
+    }, nullptr, nullptr);
+    deferred.Resolve(snapshot);
+  }
+
+  void OnError(const Napi::Error &error) {
+    deferred.Reject(error.Value());
+  }
+
+  Napi::Promise Promise() {
+    return deferred.Promise();
+  }
+
+private:
+  Napi::Promise::Deferred deferred;
+  const std::string snapshotPath;
+  const std::shared_ptr<MemoryFileSystem> fileSystem;
+};
+
+Napi::Promise LoadSnapshot(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+  if (info.Length() < 1 || !info[0].IsString() || info[0].ToString().Utf8Value().empty()) {
+    Napi::Promise::Deferred deferred(env);
+    deferred.Reject(Napi::TypeError::New(env, "Must provide a non-empty snapshot path as first argument.").Value());
+    return deferred.Promise();
+  }
+
+  SimulatedLatency latency;
+  if (info.Length() >= 2) {
+    if (!info[1].IsObject()) {
+      Napi::Promise::Deferred deferred(env);
+      deferred.Reject(Napi::TypeError::New(env, "Options argument must be an object, if passed.").Value());
+      return deferred.Promise();
+    }
+
+    Napi::Object options = info[1].ToObject();
+    const std::string error = ParseSnapshotOptions(options, latency);
+    if (!error.empty()) {
+      Napi::Promise::Deferred deferred(env);
+      deferred.Reject(Napi::TypeError::New(env, error).Value());
+      return deferred.Promise();
+    }
+  }
+
+  LoadSnapshotWorker *worker = new LoadSnapshotWorker(env, info[0].ToString().Utf8Value(), latency);
+  worker->Queue();
   return worker->Promise();
 }
 
+#if defined(__linux__)
+// Shared by the watcher thread, the thread safe function and the close() function handed to JS. It is
+// deleted once both the thread safe function and the close() function have been finalized.
+struct WatchContext {
+  std::unique_ptr<RepositoryWatcher> watcher;
+  Napi::ThreadSafeFunction eventCallback;
+  std::mutex eventsMutex;
+  std::vector<RepositoryEvent> events;
+  std::atomic<bool> callPending;
+  int references;
+  bool closed;
+};
+
+static void ReleaseWatchContext(WatchContext *context) {
+  if (--context->references == 0) {
+    delete context;
+  }
+}
+#endif
+
+Napi::Value WatchGitRepos(const Napi::CallbackInfo& info) {
+  Napi::Env env = info.Env();
+#if defined(__linux__)
+  if (info.Length() < 1 || !info[0].IsString() || info[0].ToString().Utf8Value().empty()) {
+    Napi::TypeError::New(env, "Must provide non-empty starting path as first argument.").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  if (info.Length() < 2 || !info[1].IsFunction()) {
+    Napi::TypeError::New(env, "Must provide event callback as second argument.").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  SearchOptions searchOptions;
+  WatchOptions watchOptions;
+  if (info.Length() >= 3) {
+    if (!info[2].IsObject()) {
+      Napi::TypeError::New(env, "Options argument must be an object, if passed.").ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+
+    Napi::Object options = info[2].ToObject();
+    const std::string error = ParseWatchOptions(options, searchOptions, watchOptions);
+    if (!error.empty()) {
+      Napi::TypeError::New(env, error).ThrowAsJavaScriptException();
+      return env.Undefined();
+    }
+  }
+
+  WatchContext *context = new WatchContext;
+  context->callPending = false;
+  context->references = 2;
+  context->closed = false;
+  context->eventCallback = Napi::ThreadSafeFunction::New(
+    env,
+    info[1].As<Napi::Function>(),
+    "findGitRepos.watch",
+    0,
+    1,
+    context,
+    [](Napi::Env env, WatchContext *context) {
+      ReleaseWatchContext(context);
+    }
+  );
+
+  auto deliverEvents = [](Napi::Env env, Napi::Function jsCallback, WatchContext *context) {
+    std::vector<RepositoryEvent> events;
+    {
+      std::lock_guard<std::mutex> lock(context->eventsMutex);
+      context->callPending = false;
+      events.swap(context->events);
+    }
+
+    Napi::Array eventArray = Napi::Array::New(env, events.size());
+    for (size_t i = 0; i < events.size(); ++i) {
+      Napi::Object event = Napi::Object::New(env);
+      event["type"] = Napi::String::New(env, events[i].type == RepositoryEvent::Added ? "added" : "removed");
+      event["path"] = Napi::String::New(env, events[i].path);
+      eventArray[(uint32_t)i] = event;
+    }
+
+    jsCallback.Call({ eventArray });
+  };
+
+  // Events are appended to the context, and one JS call at a time picks up everything appended so far.
+  context->watcher.reset(new RepositoryWatcher(
+    info[0].ToString(),
+    searchOptions,
+    watchOptions.maxWatches,
+    watchOptions.pollIntervalMS,
+    [context, deliverEvents](std::vector<RepositoryEvent> &events) {
+      {
+        std::lock_guard<std::mutex> lock(context->eventsMutex);
+        std::move(events.begin(), events.end(), std::back_inserter(context->events));
+      }
+
+      if (!context->callPending.exchange(true)) {
+        context->eventCallback.NonBlockingCall(context, deliverEvents);
+      }
+    }
+  ));
+
+  if (!context->watcher->start()) {
+    context->closed = true;
+    context->eventCallback.Release();
+    ReleaseWatchContext(context);
+    Napi::Error::New(env, "Could not initialize inotify.").ThrowAsJavaScriptException();
+    return env.Undefined();
+  }
+
+  Napi::Function close = Napi::Function::New(env, [](const Napi::CallbackInfo& info) -> Napi::Value {
+    WatchContext *context = static_cast<WatchContext *>(info.Data());
+    if (!context->closed) {
+      context->closed = true;
+      context->watcher->stop();
+      context->eventCallback.Release();
+    }
+    return info.Env().Undefined();
+  }, "close", context);
+  close.AddFinalizer([](Napi::Env env, WatchContext *context) {
+    ReleaseWatchContext(context);
+  }, context);
+
+  Napi::Object watcher = Napi::Object::New(env);
+  watcher["close"] = close;
+  return watcher;
+#else
+  Napi::Error::New(env, "findGitRepos.watch is only supported on Linux.").ThrowAsJavaScriptException();
+  return env.Undefined();
+#endif
+}
 
 Napi::Object Init(Napi::Env env, Napi::Object exports) {
-  return Napi::Function::New(env, FindGitRepos);
+  env.SetInstanceData(new ScanCoordinator);
+
+  Napi::Function findGitRepos = Napi::Function::New(env, FindGitRepos);
+  findGitRepos["stream"] = Napi::Function::New(env, StreamGitRepos);
+  findGitRepos["watch"] = Napi::Function::New(env, WatchGitRepos);
+  findGitRepos["loadSnapshot"] = Napi::Function::New(env, LoadSnapshot);
+  return findGitRepos;
 }
 
 NODE_API_MODULE(hello, Init)
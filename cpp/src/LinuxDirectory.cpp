@@ -0,0 +1,223 @@
+#include "../includes/LinuxDirectory.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+  const size_t kDirectoryReaderBufferSize = 64 * 1024;
+
+  struct linux_dirent64 {
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+  };
+
+  std::atomic<int> numRetainedDescriptors(0);
+
+  #if defined(FIND_GIT_REPOS_BENCHMARKS)
+  // Benchmark builds report every entry without a type when FIND_GIT_REPOS_HIDE_ENTRY_TYPES is set, so
+  // the lookups of file systems that do not report types are measured on a disk that does.
+  const bool hideEntryTypes = getenv("FIND_GIT_REPOS_HIDE_ENTRY_TYPES") != nullptr;
+  #endif
+
+  // Descriptors of directories with pending children are kept open up to a fraction of the process limit,
+  // past that children are opened relative to the closest ancestor that still has one.
+  int maxRetainedDescriptors() {
+    static const int limit = []() {
+      struct rlimit descriptorLimit;
+      if (getrlimit(RLIMIT_NOFILE, &descriptorLimit) < 0 || descriptorLimit.rlim_cur == RLIM_INFINITY) {
+        return 1024;
+      }
+
+      rlim_t quarter = descriptorLimit.rlim_cur / 4;
+      return quarter < 64 ? 64 : (quarter > 4096 ? 4096 : (int)quarter);
+    }();
+    return limit;
+  }
+
+  // O_NOATIME is only allowed on files the process owns, the others are opened the usual way.
+  int openAt(int directoryDescriptor, const char *path, int flags, bool noAccessTime) {
+    if (noAccessTime) {
+      const int descriptor = openat(directoryDescriptor, path, flags | O_NOATIME);
+      if (descriptor >= 0 || errno != EPERM) {
+        return descriptor;
+      }
+    }
+    return openat(directoryDescriptor, path, flags);
+  }
+}
+
+DirectoryNode::DirectoryNode(std::string rootPath):
+  mName(rootPath),
+  mDescriptor(-1),
+  mRetained(false)
+{}
+
+DirectoryNode::DirectoryNode(std::shared_ptr<DirectoryNode> parent, std::string name):
+  mParent(parent),
+  mName(name),
+  mDescriptor(-1),
+  mRetained(false)
+{}
+
+DirectoryNode::~DirectoryNode() {
+  if (mDescriptor >= 0) {
+    close(mDescriptor);
+  }
+
+  if (mRetained) {
+    --numRetainedDescriptors;
+  }
+}
+
+int DirectoryNode::openDescriptor(bool noAccessTime) {
+  if (!mParent) {
+    mDescriptor = openAt(AT_FDCWD, mName.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC, noAccessTime);
+    return mDescriptor;
+  }
+
+  std::string relativePath;
+  const DirectoryNode *ancestor = closestOpenAncestor(relativePath);
+
+  const int flags = O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC;
+  mDescriptor = ancestor->mDescriptor >= 0
+    ? openAt(ancestor->mDescriptor, relativePath.c_str(), flags, noAccessTime)
+    : openAt(AT_FDCWD, (ancestor->mName + '/' + relativePath).c_str(), flags, noAccessTime);
+  return mDescriptor;
+}
+
+int DirectoryNode::status(struct stat *statBuffer) const {
+  if (!mParent) {
+    return stat(mName.c_str(), statBuffer);
+  }
+
+  std::string relativePath;
+  const DirectoryNode *ancestor = closestOpenAncestor(relativePath);
+  return ancestor->mDescriptor >= 0
+    ? fstatat(ancestor->mDescriptor, relativePath.c_str(), statBuffer, AT_SYMLINK_NOFOLLOW)
+    : lstat((ancestor->mName + '/' + relativePath).c_str(), statBuffer);
+}
+
+const DirectoryNode *DirectoryNode::closestOpenAncestor(std::string &relativePath) const {
+  relativePath = mName;
+  const DirectoryNode *ancestor = mParent.get();
+  while (ancestor->mDescriptor < 0 && ancestor->mParent) {
+    relativePath = ancestor->mName + '/' + relativePath;
+    ancestor = ancestor->mParent.get();
+  }
+  return ancestor;
+}
+
+// Must be called before any child is handed to another thread, the descriptor is read-only afterwards.
+void DirectoryNode::releaseDescriptor(bool hasChildren) {
+  if (mDescriptor < 0) {
+    return;
+  }
+
+  if (hasChildren && ++numRetainedDescriptors <= maxRetainedDescriptors()) {
+    mRetained = true;
+    return;
+  }
+
+  if (hasChildren) {
+    --numRetainedDescriptors;
+  }
+
+  close(mDescriptor);
+  mDescriptor = -1;
+}
+
+const std::string &DirectoryNode::name() const {
+  return mName;
+}
+
+std::string DirectoryNode::path() const {
+  if (!mParent) {
+    return mName;
+  }
+
+  return mParent->path() + '/' + mName;
+}
+
+size_t DirectoryNode::memoryUsage() const {
+  return sizeof(*this) + mName.capacity();
+}
+
+DirectoryReader::DirectoryReader():
+  mBuffer(kDirectoryReaderBufferSize),
+  mDescriptor(-1),
+  mNumReads(0),
+  mError(0),
+  mBufferLength(0),
+  mBufferOffset(0)
+{}
+
+void DirectoryReader::reset(int descriptor) {
+  mDescriptor = descriptor;
+  mNumReads = 0;
+  mError = 0;
+  mBufferLength = 0;
+  mBufferOffset = 0;
+}
+
+bool DirectoryReader::next(const char *&name, unsigned char &type) {
+  if (mBufferOffset >= mBufferLength) {
+    mBufferLength = syscall(SYS_getdents64, mDescriptor, mBuffer.data(), mBuffer.size());
+    mBufferOffset = 0;
+    ++mNumReads;
+    if (mBufferLength < 0) {
+      mError = errno;
+    }
+    if (mBufferLength <= 0) {
+      return false;
+    }
+  }
+
+  const linux_dirent64 *entry = reinterpret_cast<const linux_dirent64 *>(mBuffer.data() + mBufferOffset);
+  mBufferOffset += entry->d_reclen;
+  name = entry->d_name;
+  type = entry->d_type;
+  #if defined(FIND_GIT_REPOS_BENCHMARKS)
+  if (hideEntryTypes) {
+    type = DT_UNKNOWN;
+  }
+  #endif
+  return true;
+}
+
+size_t DirectoryReader::numReads() const {
+  return mNumReads;
+}
+
+int DirectoryReader::error() const {
+  return mError;
+}
+
+bool readFileAt(int directoryDescriptor, const std::string &path, std::string &contents, size_t maxSize, bool cacheHints) {
+  const int descriptor = openAt(directoryDescriptor, path.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW | O_NONBLOCK, cacheHints);
+  if (descriptor < 0) {
+    return false;
+  }
+
+  contents.resize(maxSize);
+  const ssize_t length = read(descriptor, &contents[0], maxSize);
+  if (cacheHints) {
+    posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+  }
+  close(descriptor);
+  if (length < 0) {
+    contents.clear();
+    return false;
+  }
+
+  contents.resize(length);
+  return true;
+}
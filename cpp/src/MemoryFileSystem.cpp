@@ -0,0 +1,294 @@
+#include "../includes/MemoryFileSystem.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+namespace {
+  // Sleeps are only precise to tens of microseconds, shorter latencies are spun.
+  const std::uint32_t kMinSleepMicroseconds = 100;
+  const std::uint32_t kNoNode = UINT32_MAX;
+
+  void simulateLatency(std::uint32_t microseconds) {
+    if (!microseconds) {
+      return;
+    }
+
+    const std::chrono::microseconds latency(microseconds);
+    if (microseconds >= kMinSleepMicroseconds) {
+      std::this_thread::sleep_for(latency);
+      return;
+    }
+
+    const auto due = std::chrono::steady_clock::now() + latency;
+    while (std::chrono::steady_clock::now() < due) {}
+  }
+
+  EntryType entryType(char letter) {
+    switch (letter) {
+      case 'd':
+      case 'D':
+        return EntryType::Directory;
+      case 'f':
+      case 'F':
+        return EntryType::File;
+      case 'l':
+      case 'L':
+        return EntryType::Symlink;
+      default:
+        return EntryType::Other;
+    }
+  }
+
+  void appendUnescaped(const char *text, const char *end, std::string &out) {
+    for (; text < end; ++text) {
+      if (*text != '\\' || text + 1 == end) {
+        out += *text;
+        continue;
+      }
+
+      switch (*++text) {
+        case 'n':
+          out += '\n';
+          break;
+        case 'r':
+          out += '\r';
+          break;
+        case 't':
+          out += '\t';
+          break;
+        default:
+          out += *text;
+      }
+    }
+  }
+}
+
+MemoryFileSystem::MemoryFileSystem(const SimulatedLatency &latency):
+  mLatency(latency)
+{}
+
+bool MemoryFileSystem::load(const std::string &snapshotPath, std::string &error) {
+  mNodes.clear();
+  mChildren.clear();
+  mStrings.clear();
+
+  std::ifstream snapshot(snapshotPath, std::ios::binary);
+  if (!snapshot) {
+    error = "could not open " + snapshotPath;
+    return false;
+  }
+
+  // The directories leading to the current line, one per depth.
+  std::vector<std::uint32_t> ancestors;
+  std::string line;
+  for (size_t lineNumber = 1; std::getline(snapshot, line); ++lineNumber) {
+    if (!line.empty() && line.back() == '\r') {
+      line.pop_back();
+    }
+    if (line.empty()) {
+      continue;
+    }
+
+    const char *text = line.c_str();
+    const char *lineEnd = text + line.size();
+    char *depthEnd = nullptr;
+    const unsigned long depth = strtoul(text, &depthEnd, 10);
+    const char *type = depthEnd + 1;
+    const char *name = std::min<const char *>(type + 2, lineEnd);
+    const char *nameEnd = std::find(name, lineEnd, '\t');
+    if (
+      depthEnd == text
+      || *depthEnd != '\t'
+      || type >= lineEnd
+      || (type + 1 < lineEnd && type[1] != '\t')
+      || (depth > 0 && name == nameEnd)
+    ) {
+      error = "line " + std::to_string(lineNumber) + " is not <depth>\\t<type>\\t<name>";
+      mNodes.clear();
+      return false;
+    }
+    if ((depth == 0) != mNodes.empty() || depth > ancestors.size()) {
+      error = "line " + std::to_string(lineNumber) + " is at depth " + std::to_string(depth)
+        + ", which does not follow the previous line";
+      mNodes.clear();
+      return false;
+    }
+
+    ancestors.resize(depth);
+    const std::uint32_t parent = depth == 0 ? kNoNode : ancestors.back();
+    if (parent != kNoNode && mNodes[parent].type != EntryType::Directory) {
+      error = "line " + std::to_string(lineNumber) + " is inside an entry that is not a directory";
+      mNodes.clear();
+      return false;
+    }
+
+    Node node;
+    node.name = mStrings.size();
+    mStrings.append(name, nameEnd);
+    mStrings += '\0';
+    node.contents = mStrings.size();
+    if (nameEnd < lineEnd) {
+      appendUnescaped(nameEnd + 1, lineEnd, mStrings);
+    }
+    node.contentsLength = (std::uint32_t)(mStrings.size() - node.contents);
+    node.parent = parent;
+    node.firstChild = 0;
+    node.numChildren = 0;
+    node.type = entryType(*type);
+    node.listedAsUnknown = *type >= 'A' && *type <= 'Z';
+
+    ancestors.push_back((std::uint32_t)mNodes.size());
+    mNodes.push_back(node);
+    if (parent != kNoNode) {
+      ++mNodes[parent].numChildren;
+    }
+  }
+
+  if (mNodes.empty() || mNodes[0].type != EntryType::Directory) {
+    error = "the root of " + snapshotPath + " is not a directory";
+    mNodes.clear();
+    return false;
+  }
+
+  // Lays out the children of every directory next to each other, then sorts each of them by name so
+  // paths are resolved with a binary search.
+  std::uint32_t nextChild = 0;
+  for (Node &node : mNodes) {
+    node.firstChild = nextChild;
+    nextChild += node.numChildren;
+    node.numChildren = 0;
+  }
+  mChildren.resize(nextChild);
+  for (std::uint32_t i = 1; i < mNodes.size(); ++i) {
+    Node &parent = mNodes[mNodes[i].parent];
+    mChildren[parent.firstChild + parent.numChildren++] = i;
+  }
+
+  const auto byName = [this](std::uint32_t a, std::uint32_t b) {
+    return strcmp(name(a), name(b)) < 0;
+  };
+  for (const Node &node : mNodes) {
+    const auto first = mChildren.begin() + node.firstChild;
+    const auto last = first + node.numChildren;
+    std::sort(first, last, byName);
+    const auto duplicate = std::adjacent_find(first, last, [this](std::uint32_t a, std::uint32_t b) {
+      return strcmp(name(a), name(b)) == 0;
+    });
+    if (duplicate != last) {
+      error = std::string("the snapshot holds ") + name(*duplicate) + " twice in the same directory";
+      mNodes.clear();
+      mChildren.clear();
+      return false;
+    }
+  }
+
+  return true;
+}
+
+size_t MemoryFileSystem::numEntries() const {
+  return mNodes.size();
+}
+
+const char *MemoryFileSystem::name(std::uint32_t index) const {
+  return mStrings.c_str() + mNodes[index].name;
+}
+
+int MemoryFileSystem::find(const std::string &path, std::uint32_t &index) const {
+  if (mNodes.empty()) {
+    return ENOENT;
+  }
+
+  index = 0;
+  std::string component;
+  for (size_t start = 0; start <= path.size();) {
+    size_t end = path.find_first_of("/\\", start);
+    if (end == std::string::npos) {
+      end = path.size();
+    }
+    component.assign(path, start, end - start);
+    start = end + 1;
+
+    if (component.empty() || component == ".") {
+      continue;
+    }
+    if (mNodes[index].type != EntryType::Directory) {
+      return ENOTDIR;
+    }
+    if (component == "..") {
+      index = mNodes[index].parent == kNoNode ? 0 : mNodes[index].parent;
+      continue;
+    }
+
+    const Node &directory = mNodes[index];
+    const auto first = mChildren.begin() + directory.firstChild;
+    const auto last = first + directory.numChildren;
+    const auto child = std::lower_bound(first, last, component, [this](std::uint32_t child, const std::string &component) {
+      return strcmp(name(child), component.c_str()) < 0;
+    });
+    if (child == last || component != name(*child)) {
+      return ENOENT;
+    }
+    index = *child;
+  }
+  return 0;
+}
+
+int MemoryFileSystem::listDirectory(const std::string &path, const EntryCallback &onEntry) {
+  simulateLatency(mLatency.listMicroseconds);
+
+  std::uint32_t index;
+  const int error = find(path, index);
+  if (error) {
+    return error;
+  }
+
+  const Node &directory = mNodes[index];
+  if (directory.type != EntryType::Directory) {
+    return ENOTDIR;
+  }
+
+  for (std::uint32_t i = 0; i < directory.numChildren; ++i) {
+    const std::uint32_t child = mChildren[directory.firstChild + i];
+    if (!onEntry(name(child), mNodes[child].listedAsUnknown ? EntryType::Unknown : mNodes[child].type)) {
+      break;
+    }
+  }
+  return 0;
+}
+
+// Snapshots do not record the targets of symlinks, following one leads nowhere.
+int MemoryFileSystem::status(const std::string &path, bool followSymlink, EntryStatus &status) {
+  simulateLatency(mLatency.statMicroseconds);
+
+  std::uint32_t index;
+  const int error = find(path, index);
+  if (error) {
+    return error;
+  }
+  if (followSymlink && mNodes[index].type == EntryType::Symlink) {
+    return ENOENT;
+  }
+
+  status.device = 1;
+  status.inode = (std::uint64_t)index + 1;
+  status.isDirectory = mNodes[index].type == EntryType::Directory;
+  return 0;
+}
+
+bool MemoryFileSystem::readFile(const std::string &path, std::string &contents, size_t maxSize) {
+  simulateLatency(mLatency.readMicroseconds);
+
+  std::uint32_t index;
+  if (find(path, index) || mNodes[index].type != EntryType::File) {
+    return false;
+  }
+
+  const Node &file = mNodes[index];
+  contents.assign(mStrings, file.contents, std::min<size_t>(file.contentsLength, maxSize));
+  return true;
+}
@@ -0,0 +1,158 @@
+#include "../includes/MountTable.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+
+namespace {
+  const char *const kPseudoFileSystemTypes[] = {
+    "autofs", "binfmt_misc", "bpf", "cgroup", "cgroup2", "configfs", "debugfs", "devpts", "devtmpfs",
+    "efivarfs", "fusectl", "hugetlbfs", "mqueue", "nsfs", "proc", "pstore", "rpc_pipefs", "securityfs",
+    "selinuxfs", "sysfs", "tracefs"
+  };
+
+  // Spaces, tabs, newlines and backslashes in mountinfo paths are written as three digit octal escapes.
+  std::string unescape(const std::string &field) {
+    std::string result;
+    result.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+      if (field[i] == '\\' && i + 3 < field.size()
+        && field[i + 1] >= '0' && field[i + 1] <= '7'
+        && field[i + 2] >= '0' && field[i + 2] <= '7'
+        && field[i + 3] >= '0' && field[i + 3] <= '7') {
+        result.push_back((char)((field[i + 1] - '0') * 64 + (field[i + 2] - '0') * 8 + (field[i + 3] - '0')));
+        i += 3;
+      } else {
+        result.push_back(field[i]);
+      }
+    }
+    return result;
+  }
+
+  std::string parentPath(const std::string &path) {
+    const size_t slash = path.rfind('/');
+    return slash == 0 || slash == std::string::npos ? "/" : path.substr(0, slash);
+  }
+}
+
+bool MountTable::load(const char *mountInfoPath) {
+  mMounts.clear();
+  mMountsByPath.clear();
+  mMountAncestors.clear();
+
+  std::ifstream mountInfo(mountInfoPath);
+  if (!mountInfo) {
+    return false;
+  }
+
+  // 36 35 98:0 /mnt1 /mnt/parent rw,noatime master:1 - ext3 /dev/root rw,errors=continue
+  std::string line;
+  while (std::getline(mountInfo, line)) {
+    std::istringstream fields(line);
+    std::string mountId, parentId, device, root, mountPoint, field;
+    if (!(fields >> mountId >> parentId >> device >> root >> mountPoint)) {
+      continue;
+    }
+
+    // Optional fields run up to a single hyphen.
+    while (fields >> field && field != "-") {}
+    std::string fileSystemType;
+    if (field != "-" || !(fields >> fileSystemType)) {
+      continue;
+    }
+
+    const size_t colon = device.find(':');
+    if (colon == std::string::npos) {
+      continue;
+    }
+
+    Mount mount;
+    mount.path = unescape(mountPoint);
+    mount.fileSystemType = fileSystemType;
+    mount.device = makedev(strtoul(device.c_str(), nullptr, 10), strtoul(device.c_str() + colon + 1, nullptr, 10));
+
+    mMountsByPath[mount.path] = mMounts.size();
+    for (std::string ancestor = mount.path; ancestor != "/"; ) {
+      ancestor = parentPath(ancestor);
+      if (!mMountAncestors.insert(ancestor).second) {
+        break;
+      }
+    }
+    mMounts.push_back(std::move(mount));
+  }
+
+  return !mMounts.empty();
+}
+
+size_t MountTable::size() const {
+  return mMounts.size();
+}
+
+const Mount &MountTable::operator[](size_t index) const {
+  return mMounts[index];
+}
+
+int MountTable::findContaining(const std::string &path) const {
+  for (std::string prefix = path; ; prefix = parentPath(prefix)) {
+    const int mount = findAt(prefix);
+    if (mount >= 0 || prefix == "/") {
+      return mount;
+    }
+  }
+}
+
+int MountTable::findAt(const std::string &path) const {
+  auto mount = mMountsByPath.find(path);
+  return mount == mMountsByPath.end() ? -1 : (int)mount->second;
+}
+
+bool MountTable::hasMountsBelow(const std::string &path) const {
+  return mMountAncestors.count(path) > 0;
+}
+
+bool MountTable::isPseudoFileSystem(const std::string &fileSystemType) {
+  for (const char *pseudoFileSystemType : kPseudoFileSystemTypes) {
+    if (fileSystemType == pseudoFileSystemType) {
+      return true;
+    }
+  }
+  return false;
+}
+
+std::vector<bool> probeMounts(const std::vector<std::string> &paths, const std::vector<std::uint32_t> &timeoutsMS) {
+  struct ProbeState {
+    explicit ProbeState(size_t numPaths): answered(numPaths, false) {}
+
+    std::mutex mutex;
+    std::condition_variable condition;
+    std::vector<bool> answered;
+  };
+
+  std::shared_ptr<ProbeState> state(new ProbeState(paths.size()));
+  for (size_t i = 0; i < paths.size(); ++i) {
+    std::thread([state, i, path = paths[i]]() {
+      struct stat statBuffer;
+      stat(path.c_str(), &statBuffer);
+
+      std::lock_guard<std::mutex> lock(state->mutex);
+      state->answered[i] = true;
+      state->condition.notify_all();
+    }).detach();
+  }
+
+  const auto start = std::chrono::steady_clock::now();
+  std::unique_lock<std::mutex> lock(state->mutex);
+  for (size_t i = 0; i < paths.size(); ++i) {
+    state->condition.wait_until(lock, start + std::chrono::milliseconds(timeoutsMS[i]), [&state, i]() {
+      return state->answered[i];
+    });
+  }
+  return state->answered;
+}
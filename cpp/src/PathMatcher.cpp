@@ -0,0 +1,248 @@
+#include "../includes/PathMatcher.h"
+
+#include <cctype>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace {
+  const std::string kRecursiveSegment = "**";
+
+  size_t lowestSetBit(PathMatcher::State state) {
+    #if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, state);
+    return index;
+    #else
+    return __builtin_ctzll(state);
+    #endif
+  }
+
+  // Names are matched case insensitively on Windows, like the file system does.
+  void normalizeName(std::string &name) {
+    #if defined(_WIN32)
+    for (auto &character : name) {
+      character = (char)tolower((unsigned char)character);
+    }
+    #endif
+  }
+
+  bool hasWildcard(const std::string &segment) {
+    return segment.find_first_of("*?[") != std::string::npos;
+  }
+
+  bool matchCharacterClass(const char *&pattern, char character) {
+    const char *cursor = pattern + 1;
+    const bool negated = *cursor == '!' || *cursor == '^';
+    if (negated) {
+      ++cursor;
+    }
+
+    bool matched = false;
+    bool first = true;
+    while (*cursor && (first || *cursor != ']')) {
+      first = false;
+      if (cursor[1] == '-' && cursor[2] && cursor[2] != ']') {
+        matched = matched || (character >= cursor[0] && character <= cursor[2]);
+        cursor += 3;
+      } else {
+        matched = matched || character == *cursor;
+        ++cursor;
+      }
+    }
+
+    // An unterminated class is matched as a literal '['.
+    if (!*cursor) {
+      return character == '[';
+    }
+
+    pattern = cursor;
+    return matched != negated;
+  }
+}
+
+bool matchGlob(const char *pattern, const char *name) {
+  const char *starPattern = nullptr;
+  const char *starName = nullptr;
+
+  while (*name) {
+    const char *nextPattern = pattern;
+    if (*pattern == '*') {
+      starPattern = ++pattern;
+      starName = name;
+      continue;
+    }
+
+    if (*pattern == '?' || (*pattern == '[' && matchCharacterClass(nextPattern, *name)) || (*pattern != '[' && *pattern == *name)) {
+      pattern = nextPattern + 1;
+      ++name;
+      continue;
+    }
+
+    if (!starPattern) {
+      return false;
+    }
+
+    pattern = starPattern;
+    name = ++starName;
+  }
+
+  while (*pattern == '*') {
+    ++pattern;
+  }
+  return !*pattern;
+}
+
+PathMatcher::PathMatcher():
+  mAcceptingPositions(0),
+  mRecursivePositions(0),
+  mInitialState(0),
+  mEmpty(true)
+{}
+
+bool PathMatcher::addExclude(const std::string &pattern) {
+  return addPattern(pattern, true);
+}
+
+bool PathMatcher::addInclude(const std::string &pattern) {
+  return addPattern(pattern, false);
+}
+
+bool PathMatcher::addPattern(const std::string &pattern, bool exclude) {
+  std::string normalized = pattern;
+  normalizeName(normalized);
+  while (normalized.size() > 1 && normalized.back() == '/') {
+    normalized.pop_back();
+  }
+
+  // "**/name" matches name at any depth, which is what a plain name does already.
+  while (normalized.compare(0, 3, "**/") == 0) {
+    normalized.erase(0, 3);
+  }
+
+  if (normalized.empty() || normalized == "/") {
+    return false;
+  }
+
+  if (normalized.find('/') == std::string::npos) {
+    NamePatterns &namePatterns = exclude ? mExcludeNames : mIncludeNames;
+    if (hasWildcard(normalized)) {
+      namePatterns.globs.push_back(normalized);
+    } else {
+      namePatterns.literals.insert(normalized);
+    }
+    mEmpty = false;
+    return true;
+  }
+
+  PathPattern pathPattern;
+  pathPattern.exclude = exclude;
+  pathPattern.firstPosition = mPatternOfPosition.size();
+  size_t segmentStart = 0;
+  while (segmentStart <= normalized.size()) {
+    size_t segmentEnd = normalized.find('/', segmentStart);
+    if (segmentEnd == std::string::npos) {
+      segmentEnd = normalized.size();
+    }
+
+    if (segmentEnd > segmentStart) {
+      pathPattern.segments.push_back(normalized.substr(segmentStart, segmentEnd - segmentStart));
+    }
+    segmentStart = segmentEnd + 1;
+  }
+
+  // Each segment is a position in the automaton, plus one accepting position per pattern.
+  const size_t numPositions = pathPattern.segments.size() + 1;
+  if (mPatternOfPosition.size() + numPositions > kMaxPathSegments) {
+    return false;
+  }
+
+  mPatternOfPosition.insert(mPatternOfPosition.end(), numPositions, mPathPatterns.size());
+  for (size_t i = 0; i < pathPattern.segments.size(); ++i) {
+    if (pathPattern.segments[i] == kRecursiveSegment) {
+      mRecursivePositions |= State(1) << (pathPattern.firstPosition + i);
+    }
+  }
+  mAcceptingPositions |= State(1) << (pathPattern.firstPosition + pathPattern.segments.size());
+  mPathPatterns.push_back(pathPattern);
+  mInitialState |= closure(mPathPatterns.back(), 0);
+  mEmpty = false;
+  return true;
+}
+
+bool PathMatcher::empty() const {
+  return mEmpty;
+}
+
+PathMatcher::State PathMatcher::initialState() const {
+  return mInitialState;
+}
+
+// A '**' may match no segment at all, unless it ends the pattern: like in gitignore, "a/**" matches what is
+// inside a but not a itself.
+PathMatcher::State PathMatcher::closure(const PathPattern &pattern, size_t segment) const {
+  State state = State(1) << (pattern.firstPosition + segment);
+  while (segment + 1 < pattern.segments.size() && pattern.segments[segment] == kRecursiveSegment) {
+    ++segment;
+    state |= State(1) << (pattern.firstPosition + segment);
+  }
+  return state;
+}
+
+bool PathMatcher::matchesName(const NamePatterns &patterns, const std::string &name) const {
+  if (patterns.literals.count(name)) {
+    return true;
+  }
+
+  for (const auto &glob : patterns.globs) {
+    if (matchGlob(glob.c_str(), name.c_str())) {
+      return true;
+    }
+  }
+  return false;
+}
+
+PathMatcher::State PathMatcher::transition(State state, const std::string &name, bool &matchesExclude, bool &matchesInclude) const {
+  State nextState = 0;
+  for (State remaining = state & ~mAcceptingPositions; remaining; remaining &= remaining - 1) {
+    const size_t position = lowestSetBit(remaining);
+    const PathPattern &pattern = mPathPatterns[mPatternOfPosition[position]];
+    const size_t segment = position - pattern.firstPosition;
+
+    if (mRecursivePositions & (State(1) << position)) {
+      nextState |= (State(1) << position) | closure(pattern, segment + 1);
+    } else if (matchGlob(pattern.segments[segment].c_str(), name.c_str())) {
+      nextState |= closure(pattern, segment + 1);
+    }
+  }
+
+  for (State accepted = nextState & mAcceptingPositions; accepted; accepted &= accepted - 1) {
+    const size_t position = lowestSetBit(accepted);
+    if (mPathPatterns[mPatternOfPosition[position]].exclude) {
+      matchesExclude = true;
+    } else {
+      matchesInclude = true;
+    }
+  }
+  return nextState;
+}
+
+bool PathMatcher::isExcluded(State state, const char *name, State &childState) const {
+  childState = 0;
+  if (mEmpty) {
+    return false;
+  }
+
+  // Every entry of every directory gets here, so the name is copied into a buffer of the thread rather
+  // than into a string of its own.
+  thread_local std::string normalized;
+  normalized.assign(name);
+  normalizeName(normalized);
+  bool matchesExclude = matchesName(mExcludeNames, normalized);
+  bool matchesInclude = matchesName(mIncludeNames, normalized);
+  if (state) {
+    childState = transition(state, normalized, matchesExclude, matchesInclude);
+  }
+
+  return matchesExclude && !matchesInclude;
+}
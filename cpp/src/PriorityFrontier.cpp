@@ -0,0 +1,71 @@
+#include "../includes/PriorityFrontier.h"
+
+namespace {
+  // Above every directory ranked by depth, so directories on a hint path always come first.
+  const std::int32_t kHintedPriority = 1 << 24;
+  const std::int32_t kDepthFirstPriority = 1 << 28;
+  const std::int32_t kBasePriority = 1 << 20;
+  const std::int32_t kDepthCost = 8;
+  const std::int32_t kRepositoryHomeBonus = 4 * kDepthCost;
+  const std::int32_t kRepositoryNearbyBonus = kDepthCost / 2;
+  const std::uint32_t kMaxRepositoriesNearby = 8;
+
+  bool isSeparator(char character) {
+    return character == '/' || character == '\\';
+  }
+}
+
+const char *const DirectoryRanker::kRepositoryHomes[kNumRepositoryHomes] = {
+  "code", "dev", "development", "git", "github", "gitlab", "projects", "repos", "repositories", "source",
+  "sources", "src", "work", "workspace", "workspaces"
+};
+
+void DirectoryRanker::addHint(std::string path) {
+  while (path.size() > 1 && isSeparator(path.back())) {
+    path.pop_back();
+  }
+  if (path.size() > 5 && isSeparator(path[path.size() - 5]) && path.compare(path.size() - 4, 4, ".git") == 0) {
+    path.resize(path.size() - 5);
+  }
+  if (path.empty() || !mHints.insert(path).second) {
+    return;
+  }
+
+  // Stops at the first ancestor already known, its own ancestors were added with it.
+  while (true) {
+    const size_t separator = path.find_last_of("/\\");
+    if (separator == std::string::npos || separator == 0) {
+      break;
+    }
+    path.resize(separator);
+    if (!mHintAncestors.insert(path).second) {
+      break;
+    }
+  }
+}
+
+bool DirectoryRanker::hasHints() const {
+  return !mHints.empty();
+}
+
+bool DirectoryRanker::isOnHintPath(const std::string &path) const {
+  return mHints.count(path) > 0 || mHintAncestors.count(path) > 0;
+}
+
+std::int32_t DirectoryRanker::bonus(std::int32_t parentBonus, bool likelyRepositoryHome, std::uint32_t repositoriesNearby) {
+  return parentBonus / 2
+    + (likelyRepositoryHome ? kRepositoryHomeBonus : 0)
+    + (std::int32_t)std::min(repositoriesNearby, kMaxRepositoriesNearby) * kRepositoryNearbyBonus;
+}
+
+std::int32_t DirectoryRanker::rank(std::uint32_t depth, std::int32_t bonus) {
+  return kBasePriority - (std::int32_t)std::min<std::uint32_t>(depth, kBasePriority / kDepthCost / 2) * kDepthCost + bonus;
+}
+
+std::int32_t DirectoryRanker::rankHinted(std::uint32_t depth) {
+  return kHintedPriority - (std::int32_t)std::min<std::uint32_t>(depth, kHintedPriority / 2);
+}
+
+std::int32_t DirectoryRanker::rankDepthFirst(std::uint32_t depth) {
+  return kDepthFirstPriority + (std::int32_t)std::min<std::uint32_t>(depth, kDepthFirstPriority / 2);
+}
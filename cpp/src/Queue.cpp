@@ -1,51 +1,100 @@
 #include "../includes/Queue.h"
 
-RepositoryQueue::RepositoryQueue() {
-  OPA_Queue_init(&mQueue);
-  OPA_store_int(&mNumRepositories, 0);
-}
+#include <algorithm>
+#include <cstring>
 
-RepositoryQueue::~RepositoryQueue() {
-  clear();
-}
+RepositoryRing::RepositoryRing(size_t initialCapacity, size_t maxCapacity):
+  mBuffer(new char[initialCapacity]),
+  mData(mBuffer.get()),
+  mCapacity(initialCapacity),
+  mMaxCapacity(std::max(initialCapacity, maxCapacity)),
+  mHead(0),
+  mTail(0)
+{}
 
-void RepositoryQueue::clear() {
-  while(!OPA_Queue_is_empty(&mQueue)) {
-    RepositoryNode *node;
+// The consumer only touches the buffer between reading a tail past its head and storing that tail as its
+// head. An empty ring seen by the producer means it is done with it, so the buffer can be replaced.
+void RepositoryRing::grow(size_t length) {
+  size_t capacity = mCapacity.load(std::memory_order_relaxed) * 2;
+  while (capacity < length + 1) {
+    capacity *= 2;
+  }
+  capacity = std::max(std::min(capacity, mMaxCapacity), length + 1);
 
-    OPA_decr_int(&mNumRepositories);
-    OPA_Queue_dequeue(&mQueue, node, RepositoryNode, header);
+  mBuffer.reset(new char[capacity]);
+  mData.store(mBuffer.get(), std::memory_order_relaxed);
+  mCapacity.store(capacity, std::memory_order_relaxed);
+}
 
-    delete node;
+bool RepositoryRing::push(const char *repository, size_t length) {
+  const size_t tail = mTail.load(std::memory_order_relaxed);
+  const size_t head = mHead.load(std::memory_order_acquire);
+  size_t capacity = mCapacity.load(std::memory_order_relaxed);
+  if (tail - head + length + 1 > capacity) {
+    // A path longer than the largest ring still gets one of its own size.
+    if (tail != head || (capacity >= mMaxCapacity && capacity >= length + 1)) {
+      return false;
+    }
+    grow(length);
+    capacity = mCapacity.load(std::memory_order_relaxed);
   }
-}
 
-int RepositoryQueue::count() {
-  return OPA_load_int(&mNumRepositories);
+  char *data = mData.load(std::memory_order_relaxed);
+  const size_t offset = tail % capacity;
+  const size_t firstPart = std::min(length, capacity - offset);
+  memcpy(data + offset, repository, firstPart);
+  memcpy(data, repository + firstPart, length - firstPart);
+  data[(tail + length) % capacity] = '\0';
+
+  mTail.store(tail + length + 1, std::memory_order_release);
+  return true;
 }
 
-std::string RepositoryQueue::dequeue() {
-  if (!OPA_Queue_is_empty(&mQueue)) {
-    RepositoryNode *node;
+size_t RepositoryRing::drain(std::string &batch) {
+  const size_t head = mHead.load(std::memory_order_relaxed);
+  const size_t tail = mTail.load(std::memory_order_acquire);
+  const size_t length = tail - head;
+  if (!length) {
+    return 0;
+  }
 
-    OPA_decr_int(&mNumRepositories);
-    OPA_Queue_dequeue(&mQueue, node, RepositoryNode, header);
+  const char *data = mData.load(std::memory_order_relaxed);
+  const size_t capacity = mCapacity.load(std::memory_order_relaxed);
+  const size_t offset = head % capacity;
+  const size_t firstPart = std::min(length, capacity - offset);
+  batch.append(data + offset, firstPart);
+  batch.append(data, length - firstPart);
 
-    std::string repository = node->repository;
-    delete node;
+  mHead.store(tail, std::memory_order_release);
+  return length;
+}
 
-    return repository;
+RepositoryQueue::RepositoryQueue(size_t numProducers, size_t initialRingCapacity, size_t maxRingCapacity):
+  mNumEnqueued(0)
+{
+  for (size_t i = 0; i < numProducers; ++i) {
+    mRings.emplace_back(new RepositoryRing(initialRingCapacity, maxRingCapacity));
   }
-  return NULL;
 }
 
-void RepositoryQueue::enqueue(std::string repository) {
-  RepositoryNode *node = new RepositoryNode;
+// Returns false when the producer's ring is full, the caller has to wait for the JS thread to drain it.
+bool RepositoryQueue::enqueue(size_t producer, const std::string &repository) {
+  if (!mRings[producer]->push(repository.data(), repository.size())) {
+    return false;
+  }
 
-  OPA_Queue_header_init(&node->header);
+  mNumEnqueued.fetch_add(1, std::memory_order_relaxed);
+  return true;
+}
 
-  node->repository = repository;
+size_t RepositoryQueue::dequeueAll(std::string &batch) {
+  size_t numBytes = 0;
+  for (auto &ring : mRings) {
+    numBytes += ring->drain(batch);
+  }
+  return numBytes;
+}
 
-  OPA_Queue_enqueue(&mQueue, node, RepositoryNode, header);
-  OPA_incr_int(&mNumRepositories);
+size_t RepositoryQueue::numEnqueued() const {
+  return mNumEnqueued.load(std::memory_order_relaxed);
 }
@@ -0,0 +1,203 @@
+#include "../includes/RepositoryInfo.h"
+
+#include <cstring>
+
+namespace {
+  std::string firstLine(const std::string &contents) {
+    return contents.substr(0, contents.find_first_of("\r\n"));
+  }
+
+  bool isObjectId(const std::string &line) {
+    if (line.size() != 40 && line.size() != 64) {
+      return false;
+    }
+
+    for (char character : line) {
+      if (!((character >= '0' && character <= '9') || (character >= 'a' && character <= 'f'))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  // HEAD either names a ref or holds the commit it is detached at. Anything else is not a repository.
+  bool parseHead(const std::string &contents, std::string &branch) {
+    const std::string line = firstLine(contents);
+    branch.clear();
+    if (line.compare(0, 5, "ref: ") != 0) {
+      return isObjectId(line);
+    }
+
+    const std::string ref = line.substr(5);
+    if (ref.compare(0, 11, "refs/heads/") == 0) {
+      branch = ref.substr(11);
+    }
+    return ref.compare(0, 5, "refs/") == 0;
+  }
+
+  bool isAbsolute(const std::string &path) {
+    return !path.empty() && (path[0] == '/' || path[0] == '\\' || (path.size() > 1 && path[1] == ':'));
+  }
+
+  // Appends a relative path to a directory, resolving its "." and ".." components without touching the
+  // file system.
+  std::string joinPath(std::string base, const std::string &relativePath, char separator) {
+    size_t start = 0;
+    while (start <= relativePath.size()) {
+      size_t end = relativePath.find_first_of("/\\", start);
+      if (end == std::string::npos) {
+        end = relativePath.size();
+      }
+
+      const std::string component = relativePath.substr(start, end - start);
+      start = end + 1;
+      if (component.empty() || component == ".") {
+        continue;
+      }
+
+      const size_t lastSeparator = base.find_last_of("/\\");
+      if (
+        component == ".."
+        && lastSeparator != std::string::npos
+        && lastSeparator > 0
+        && base.compare(lastSeparator + 1, std::string::npos, "..") != 0
+      ) {
+        base.erase(lastSeparator);
+      } else {
+        base += separator;
+        base += component;
+      }
+    }
+    return base;
+  }
+
+  RepositoryKind kindOfGitDir(const std::string &gitDir) {
+    std::string path = gitDir;
+    for (char &character : path) {
+      if (character == '\\') {
+        character = '/';
+      }
+    }
+    while (path.size() > 1 && path.back() == '/') {
+      path.pop_back();
+    }
+
+    const size_t nameStart = path.rfind('/');
+    const size_t parentStart = nameStart == std::string::npos || nameStart == 0 ? std::string::npos : path.rfind('/', nameStart - 1);
+    if (parentStart != std::string::npos && path.compare(parentStart + 1, nameStart - parentStart - 1, "worktrees") == 0) {
+      return RepositoryKind::Worktree;
+    }
+    if (path.find("/modules/") != std::string::npos) {
+      return RepositoryKind::Submodule;
+    }
+    return RepositoryKind::Repository;
+  }
+}
+
+RepositoryEntries::RepositoryEntries():
+  mGitFile(false),
+  mHead(false),
+  mObjects(false),
+  mRefs(false)
+{}
+
+void RepositoryEntries::add(const char *name, bool isDirectory) {
+  if (!strcmp(name, ".git")) {
+    mGitFile = !isDirectory;
+  } else if (!strcmp(name, "HEAD")) {
+    mHead = true;
+  } else if (!strcmp(name, "objects")) {
+    mObjects = true;
+  } else if (!strcmp(name, "refs")) {
+    mRefs = true;
+  }
+}
+
+bool RepositoryEntries::hasGitFile() const {
+  return mGitFile;
+}
+
+bool RepositoryEntries::looksBare() const {
+  return mHead && mObjects && mRefs;
+}
+
+bool describeRepository(
+  RepositoryLayout layout,
+  const std::string &directoryPath,
+  char separator,
+  const ReadRepositoryFile &readFile,
+  bool readHead,
+  RepositoryInfo &info
+) {
+  info.path = directoryPath;
+  info.branch.clear();
+
+  std::string contents;
+  switch (layout) {
+    case RepositoryLayout::GitDirectory:
+      info.kind = RepositoryKind::Repository;
+      info.gitDir = directoryPath + separator + ".git";
+      if (readHead && readFile(".git/HEAD", contents)) {
+        parseHead(contents, info.branch);
+      }
+      return true;
+
+    case RepositoryLayout::GitFile: {
+      if (!readFile(".git", contents)) {
+        return false;
+      }
+
+      const std::string line = firstLine(contents);
+      if (line.compare(0, 8, "gitdir: ") != 0 || line.size() == 8) {
+        return false;
+      }
+
+      const std::string gitDir = line.substr(8);
+      info.gitDir = isAbsolute(gitDir) ? gitDir : joinPath(directoryPath, gitDir, separator);
+      info.kind = kindOfGitDir(info.gitDir);
+      if (readHead && readFile(gitDir + "/HEAD", contents)) {
+        parseHead(contents, info.branch);
+      }
+      return true;
+    }
+
+    case RepositoryLayout::Bare:
+      info.kind = RepositoryKind::Bare;
+      info.gitDir = directoryPath;
+      if (!readFile("HEAD", contents) || !parseHead(contents, info.branch)) {
+        return false;
+      }
+      if (!readHead) {
+        info.branch.clear();
+      }
+      return true;
+  }
+
+  return false;
+}
+
+std::string encodeRepositoryInfo(const RepositoryInfo &info) {
+  std::string record;
+  record.reserve(info.path.size() + info.gitDir.size() + info.branch.size() + 4);
+  record += (char)info.kind;
+  record += '\0';
+  record += info.path;
+  record += '\0';
+  record += info.gitDir;
+  record += '\0';
+  record += info.branch;
+  return record;
+}
+
+const char *repositoryKindName(RepositoryKind kind) {
+  switch (kind) {
+    case RepositoryKind::Worktree:
+      return "worktree";
+    case RepositoryKind::Submodule:
+      return "submodule";
+    case RepositoryKind::Bare:
+      return "bare";
+    default:
+      return "repository";
+  }
+}
@@ -0,0 +1,1350 @@
+#include "../includes/RepositoryScanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include "../includes/BackgroundMode.h"
+#include "../includes/RepositoryInfo.h"
+#include "../includes/VisitedSet.h"
+#include "../includes/WorkStealingQueue.h"
+#if defined(_WIN32)
+#include "../includes/PathNode.h"
+#include "../includes/WindowsHelpers.h"
+#elif defined(__linux__)
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <fstream>
+#include <sys/stat.h>
+#include "../includes/LinuxDirectory.h"
+#include "../includes/MountTable.h"
+#include "../includes/ScanIndex.h"
+#include "../includes/StatBatch.h"
+#else
+#include <dirent.h>
+#include <errno.h>
+#include <fstream>
+#include <sys/stat.h>
+#include "../includes/PathNode.h"
+#include "../includes/ScanIndex.h"
+#endif
+
+#if defined(_WIN32)
+typedef PathNode<std::wstring> DirectoryNode;
+#elif !defined(__linux__)
+typedef PathNode<std::string> DirectoryNode;
+#endif
+
+// Entries beat the sink once every this many, so wide directories do not pay a call for each of them.
+static const std::uint64_t kEntriesPerHeartbeat = 64;
+
+struct PendingDirectory {
+  std::shared_ptr<DirectoryNode> directory;
+  std::uint32_t depth;
+  PathMatcher::State matchState;
+  // Index of the root the directory was reached from.
+  std::uint32_t root = 0;
+  // Only set by a prioritized search, see DirectoryRanker.
+  std::int32_t priority = 0;
+  // Set instead when queued over the memory limit. The frontier goes back to priority once the search is
+  // under the limit again.
+  std::int32_t depthFirstPriority = 0;
+  std::int32_t rankBonus = 0;
+  bool onHintPath = false;
+  std::shared_ptr<SiblingRepositories> siblingRepositories = nullptr;
+  #if defined(__linux__)
+  // Index into the mount table, or -1 when mounts are not tracked.
+  std::int32_t mount = -1;
+  // Whether a mount point lies below this directory, so its children have to be checked for one.
+  bool mountsBelow = false;
+  #endif
+
+  // Rough number of bytes a pending directory keeps alive, used to bound the size of the frontier.
+  size_t memoryUsage() const {
+    return sizeof(*this) + directory->memoryUsage();
+  }
+};
+
+#if defined(__linux__)
+// Caps how many directories of one file system type are scanned at once. Directories over the cap wait
+// here rather than in the work queues, so the threads keep scanning other mounts in the meantime.
+struct MountLimiter {
+  explicit MountLimiter(uint32_t _concurrency):
+    concurrency(_concurrency),
+    active(0)
+  {}
+
+  const uint32_t concurrency;
+  std::mutex mutex;
+  uint32_t active;
+  std::deque<PendingDirectory> deferred;
+};
+
+struct MountState {
+  MountState():
+    limiter(nullptr),
+    timeoutMS(0),
+    unresponsive(false)
+  {}
+
+  MountLimiter *limiter;
+  uint32_t timeoutMS;
+  // Set once a scan on the mount took longer than its timeout. Its remaining directories are skipped.
+  std::atomic<bool> unresponsive;
+};
+#endif
+
+class RepositoryScanner::Traversal {
+public:
+  Traversal(std::vector<std::string> _paths, const SearchOptions &searchOptions, ScanSink &_sink, std::atomic<bool> &_cancel):
+    paths(std::move(_paths)),
+    deduplicate(paths.size() > 1),
+    sink(_sink),
+    maxSubfolderDeep(searchOptions.maxSubfolderDeep),
+    concurrency(searchOptions.concurrency),
+    frontierMemoryLimit(searchOptions.frontierMemoryLimit),
+    fileSystem(searchOptions.fileSystem),
+    indexPath(fileSystem ? std::string() : searchOptions.indexPath),
+    subtreeOf(searchOptions.subtreeOf),
+    reportDirectories(_sink.wantsDirectories()),
+    pathMatcher(searchOptions.pathMatcher),
+    latencySampleInterval(searchOptions.latencySampleInterval),
+    classify(searchOptions.classify),
+    readHead(searchOptions.readHead),
+    prioritize(searchOptions.prioritize),
+    ranker(searchOptions.ranker),
+    // The deadline counts from the construction of the scanner, time spent waiting for a thread to run it
+    // included.
+    deadlineNS(searchOptions.deadlineMS ? wallTimeNS() + (std::uint64_t)searchOptions.deadlineMS * 1000000 : 0),
+    maxDirectories(searchOptions.maxDirectories),
+    background(searchOptions.background),
+    rateLimiter(searchOptions.directoriesPerSecond ? new RateLimiter(searchOptions.directoriesPerSecond) : nullptr),
+    #if defined(__linux__)
+    oneFileSystem(searchOptions.oneFileSystem),
+    skipPseudoFileSystems(searchOptions.skipPseudoFileSystems),
+    skipFileSystemTypes(searchOptions.skipFileSystemTypes),
+    mountLimits(searchOptions.mountLimits),
+    mountAware(false),
+    cacheHints(searchOptions.cacheHints),
+    #endif
+    cancel(_cancel)
+  {
+    pendingDirectories = 0;
+    frontierMemoryUsage = 0;
+    depthFirst = false;
+    idleThreads = 0;
+    firstRepositoryNS = -1;
+    directoriesTaken = 0;
+    overBudget = false;
+    directoriesLeft = 0;
+    threadsWithLowerIoPriority = 0;
+    threadsWithLowerCpuPriority = 0;
+  }
+
+  void run() {
+    scanStartNS = wallTimeNS();
+    setupPhase.start();
+
+    std::vector<PendingDirectory> roots;
+    #if defined(_WIN32)
+    wasNtPath.assign(paths.size(), false);
+    #endif
+    for (std::uint32_t i = 0; i < paths.size(); ++i) {
+      #if defined(_WIN32)
+      auto rootPath = convertMultiByteToWideChar(paths[i]);
+      // Paths of a provider are passed along as they are.
+      wasNtPath[i] = fileSystem || isNtPath(rootPath);
+
+      if (!wasNtPath[i]) {
+        while (!rootPath.empty() && rootPath.back() == L'\\') {
+          rootPath.pop_back();
+        }
+        if (rootPath.empty()) {
+          continue;
+        }
+        rootPath = prefixWithNtPath(rootPath);
+      }
+
+      PendingDirectory root = { std::make_shared<DirectoryNode>(rootPath), 0, pathMatcher.initialState() };
+      #else
+      PendingDirectory root = { std::make_shared<DirectoryNode>(paths[i]), 0, pathMatcher.initialState() };
+      #endif
+      if (!subtreeOf.empty() && !PlaceSubtree(paths[i], root)) {
+        continue;
+      }
+      root.root = i;
+      root.onHintPath = prioritize && ranker.isOnHintPath(ReportedPath(*root.directory, i));
+      roots.push_back(std::move(root));
+    }
+
+    workQueues.clear();
+    for (std::uint32_t i = 0; i < concurrency; ++i) {
+      if (prioritize) {
+        workQueues.emplace_back(new PriorityFrontier<PendingDirectory>);
+      } else {
+        workQueues.emplace_back(new WorkStealingQueue<PendingDirectory>);
+      }
+    }
+    threadStats.assign(concurrency, TraversalStats());
+
+    #if defined(__linux__)
+    SetUpMounts(roots);
+    #endif
+
+    #if !defined(_WIN32)
+    indexBuilders.clear();
+    if (!indexPath.empty()) {
+      previousIndex.reset(new ScanIndex(indexPath, classify ? kScanIndexClassified : 0));
+      indexBuilders.resize(concurrency);
+      // Directories modified right before or during the scan may change again within the same mtime tick,
+      // so they are not trusted on the next scan.
+      indexMtimeLimit = (std::int64_t)time(nullptr) - 1;
+    }
+    #endif
+
+    // Roots are spread over the threads, which steal from each other once their own roots are done.
+    pendingDirectories = roots.size();
+    frontierMemoryUsage = 0;
+    depthFirst = false;
+    for (size_t i = 0; i < roots.size(); ++i) {
+      frontierMemoryUsage += roots[i].memoryUsage();
+      workQueues[i % concurrency]->push(std::move(roots[i]));
+    }
+
+    setupPhase.stop();
+    traversalPhase.start();
+
+    // The calling thread is traversal thread 0, the rest are spawned for the duration of the scan. A
+    // background search lowers the priority of its threads for good, so it spawns thread 0 as well and the
+    // calling thread only waits for them.
+    std::vector<std::thread> threads;
+    for (std::uint32_t i = background ? 0 : 1; i < concurrency; ++i) {
+      threads.emplace_back([this, i]() { Traverse(i); });
+    }
+
+    if (!background) {
+      Traverse(0);
+    }
+
+    for (auto &thread : threads) {
+      thread.join();
+    }
+    traversalPhase.stop();
+    if (overBudget) {
+      directoriesLeft = pendingDirectories;
+    }
+
+    #if !defined(_WIN32)
+    if (!indexPath.empty()) {
+      indexWritePhase.start();
+      previousIndex.reset();
+      if (!cancel) {
+        ScanIndexBuilder::write(indexPath, indexBuilders, classify ? kScanIndexClassified : 0);
+      }
+      indexBuilders.clear();
+      indexWritePhase.stop();
+    }
+    #endif
+
+    for (const auto &threadStat : threadStats) {
+      summary.stats.merge(threadStat);
+    }
+    summary.setupPhase = setupPhase;
+    summary.traversalPhase = traversalPhase;
+    summary.indexWritePhase = indexWritePhase;
+    summary.firstRepositoryNS = firstRepositoryNS;
+    summary.directoriesLeft = directoriesLeft;
+    summary.ioPriorityLowered = background && threadsWithLowerIoPriority == concurrency;
+    summary.cpuPriorityLowered = background && threadsWithLowerCpuPriority == concurrency;
+  }
+
+  void Traverse(std::uint32_t threadIndex) {
+    TraversalStats &stats = threadStats[threadIndex];
+    const std::uint64_t cpuStartNS = threadCpuTimeNS();
+    std::vector<PendingDirectory> subdirectories;
+    PendingDirectory currentDirectory;
+
+    if (background) {
+      const ThreadPriority priority = lowerThreadPriority();
+      threadsWithLowerIoPriority += priority.ioLowered;
+      threadsWithLowerCpuPriority += priority.cpuLowered;
+    }
+
+    while (!cancel && !overBudget) {
+      if (!NextDirectory(threadIndex, currentDirectory)) {
+        if (pendingDirectories == 0) {
+          break;
+        }
+
+        std::unique_lock<std::mutex> lock(idleMutex);
+        ++idleThreads;
+        idleCondition.wait_for(lock, std::chrono::milliseconds(1));
+        --idleThreads;
+        continue;
+      }
+
+      frontierMemoryUsage -= currentDirectory.memoryUsage();
+      sink.heartbeat();
+
+      // The directory stays counted as pending, it is reported as left.
+      if (IsOverBudget()) {
+        overBudget = true;
+        break;
+      }
+
+      if (rateLimiter) {
+        stats.throttledNS += rateLimiter->acquire(cancel);
+      }
+
+      #if defined(__linux__)
+      MountState *mountState = mountAware && currentDirectory.mount >= 0 ? mountStates[currentDirectory.mount].get() : nullptr;
+      if (mountState && !EnterMount(currentDirectory, *mountState)) {
+        continue;
+      }
+      const std::uint64_t mountScanStartNS = mountState && mountState->timeoutMS ? wallTimeNS() : 0;
+      #endif
+
+      if (reportDirectories) {
+        sink.directoryEntered(threadIndex, ReportedPath(*currentDirectory.directory, currentDirectory.root));
+      }
+
+      const std::uint64_t repositoriesFound = stats.repositoriesFound;
+      if (latencySampleInterval && stats.shouldSampleLatency(latencySampleInterval)) {
+        const std::uint64_t scanStartNS = wallTimeNS();
+        ScanDirectory(threadIndex, currentDirectory, subdirectories);
+        RecordLatency(stats, currentDirectory, wallTimeNS() - scanStartNS);
+      } else {
+        ScanDirectory(threadIndex, currentDirectory, subdirectories);
+      }
+
+      if (!ShouldDescend(currentDirectory)) {
+        subdirectories.clear();
+      }
+      #if defined(__linux__)
+      if (mountState) {
+        LeaveMount(threadIndex, *mountState, mountScanStartNS, subdirectories);
+      }
+      if (mountAware) {
+        AssignMounts(threadIndex, currentDirectory, subdirectories);
+      }
+      #endif
+      if (prioritize) {
+        if (currentDirectory.siblingRepositories && stats.repositoriesFound != repositoriesFound) {
+          currentDirectory.siblingRepositories->add();
+        }
+        RankSubdirectories(currentDirectory, subdirectories);
+      }
+      const std::uint32_t root = currentDirectory.root;
+      currentDirectory = PendingDirectory();
+
+      if (!subdirectories.empty()) {
+        pendingDirectories += subdirectories.size();
+        size_t memoryUsage = 0;
+        for (auto &subdirectory : subdirectories) {
+          subdirectory.root = root;
+          memoryUsage += subdirectory.memoryUsage();
+          workQueues[threadIndex]->push(std::move(subdirectory));
+        }
+        subdirectories.clear();
+        stats.maxPendingDirectories = std::max<std::uint64_t>(stats.maxPendingDirectories, pendingDirectories);
+        stats.maxFrontierMemoryUsage = std::max<std::uint64_t>(stats.maxFrontierMemoryUsage, frontierMemoryUsage += memoryUsage);
+
+        if (idleThreads > 0) {
+          idleCondition.notify_all();
+        }
+      }
+
+      // Only retire the directory after its children were counted, so the pending count never drops to
+      // zero while there is still work that another thread could steal.
+      --pendingDirectories;
+      UpdateTraversalOrder();
+    }
+
+    stats.cpuTimeNS = threadCpuTimeNS() - cpuStartNS;
+  }
+
+  // The path of a directory as it is reported.
+  std::string ReportedPath(const DirectoryNode &directory, std::uint32_t root) {
+    #if defined(_WIN32)
+    std::string directoryPath;
+    convertWideCharToMultiByte(&directoryPath, directory.path(L'\\'), wasNtPath[root]);
+    return directoryPath;
+    #elif defined(__linux__)
+    return directory.path();
+    #else
+    return directory.path('/');
+    #endif
+  }
+
+  // A root below subtreeOf starts at the depth and with the match state its path has from there. Returns
+  // false when a directory on that path is excluded.
+  bool PlaceSubtree(const std::string &path, PendingDirectory &root) {
+    const auto isSeparator = [](char character) {
+      #if defined(_WIN32)
+      return character == '/' || character == '\\';
+      #else
+      return character == '/';
+      #endif
+    };
+
+    const size_t start = subtreeOf.size();
+    if (
+      path.compare(0, start, subtreeOf) != 0
+      || (path.size() > start && !isSeparator(path[start]) && !isSeparator(subtreeOf.back()))
+    ) {
+      return true;
+    }
+
+    std::string name;
+    for (size_t i = start; i <= path.size(); ++i) {
+      if (i < path.size() && !isSeparator(path[i])) {
+        name += path[i];
+        continue;
+      }
+
+      if (name.empty()) {
+        continue;
+      }
+
+      PathMatcher::State matchState;
+      if (pathMatcher.isExcluded(root.matchState, name.c_str(), matchState)) {
+        return false;
+      }
+      root.matchState = matchState;
+      ++root.depth;
+      name.clear();
+    }
+    return true;
+  }
+
+  // Only sampled directories get here, and only the slowest of them have their path built.
+  void RecordLatency(TraversalStats &stats, const PendingDirectory &directory, std::uint64_t latencyNS) {
+    stats.recordLatency(latencyNS);
+    if (!stats.isAmongSlowest(latencyNS)) {
+      return;
+    }
+
+    stats.addSlowDirectory(latencyNS, ReportedPath(*directory.directory, directory.root));
+  }
+
+  // Only a search with a budget counts the directories it takes, or looks at the clock.
+  bool IsOverBudget() {
+    return (maxDirectories && ++directoriesTaken > maxDirectories) || (deadlineNS && wallTimeNS() > deadlineNS);
+  }
+
+  // Children of a directory share one count of the repositories found in and below them, which ranks the
+  // children of each of them in turn. Paths are only built on the way to a hint.
+  void RankSubdirectories(const PendingDirectory &parent, std::vector<PendingDirectory> &subdirectories) {
+    if (subdirectories.empty()) {
+      return;
+    }
+
+    const std::uint32_t repositoriesNearby = parent.siblingRepositories ? parent.siblingRepositories->count.load() : 0;
+    const bool rankDepthFirst = depthFirst;
+    auto siblingRepositories = std::make_shared<SiblingRepositories>(parent.siblingRepositories);
+    for (auto &subdirectory : subdirectories) {
+      subdirectory.siblingRepositories = siblingRepositories;
+      subdirectory.rankBonus = DirectoryRanker::bonus(
+        parent.rankBonus,
+        DirectoryRanker::isLikelyRepositoryHome(subdirectory.directory->name()),
+        repositoriesNearby
+      );
+      subdirectory.onHintPath = parent.onHintPath && ranker.isOnHintPath(ReportedPath(*subdirectory.directory, parent.root));
+      subdirectory.priority = subdirectory.onHintPath
+        ? DirectoryRanker::rankHinted(subdirectory.depth)
+        : DirectoryRanker::rank(subdirectory.depth, subdirectory.rankBonus);
+      subdirectory.depthFirstPriority = rankDepthFirst ? DirectoryRanker::rankDepthFirst(subdirectory.depth) : 0;
+    }
+  }
+
+  // Breadth-first order finds shallow repositories first, but its frontier grows with the width of the
+  // tree. Past the memory limit the threads go depth-first, which only keeps the siblings of the
+  // directories on the current path pending, until the frontier is back under half the limit.
+  void UpdateTraversalOrder() {
+    const size_t memoryUsage = frontierMemoryUsage;
+    if (memoryUsage > frontierMemoryLimit) {
+      depthFirst = true;
+    } else if (memoryUsage < frontierMemoryLimit / 2) {
+      depthFirst = false;
+    }
+  }
+
+  bool NextDirectory(std::uint32_t threadIndex, PendingDirectory &directory) {
+    if (workQueues[threadIndex]->pop(directory, depthFirst)) {
+      return true;
+    }
+
+    for (std::uint32_t i = 1; i < concurrency; ++i) {
+      if (workQueues[(threadIndex + i) % concurrency]->steal(directory, depthFirst)) {
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  bool ShouldDescend(const PendingDirectory &directory) {
+    return maxSubfolderDeep == 0 || directory.depth < maxSubfolderDeep;
+  }
+
+  // The first root to reach a directory searches it, and reports the repository it may be.
+  bool ClaimDirectory(std::uint32_t threadIndex, std::uint64_t device, std::uint64_t inode) {
+    if (visited.insert(device, inode)) {
+      return true;
+    }
+
+    ++threadStats[threadIndex].duplicateDirectories;
+    return false;
+  }
+
+  #if defined(__linux__)
+  // Directories are only tied to a mount when one of the mount options is used. The mount table is read
+  // once, and the mounts below the root with a timeout are probed before the traversal starts, so a dead
+  // server is skipped rather than blocking a traversal thread for good.
+  void SetUpMounts(std::vector<PendingDirectory> &roots) {
+    mountStates.clear();
+    mountLimiters.clear();
+    mountAware = !fileSystem
+      && (oneFileSystem || skipPseudoFileSystems || !skipFileSystemTypes.empty() || !mountLimits.empty())
+      && mountTable.load();
+    if (!mountAware) {
+      return;
+    }
+
+    // A root that cannot be resolved is searched without tracking its mounts, it most likely fails to open.
+    canonicalRootPaths.assign(paths.size(), std::string());
+    rootDevices.assign(paths.size(), 0);
+    for (PendingDirectory &root : roots) {
+      char *resolvedPath = realpath(paths[root.root].c_str(), nullptr);
+      if (!resolvedPath) {
+        continue;
+      }
+      canonicalRootPaths[root.root] = resolvedPath;
+      free(resolvedPath);
+
+      root.mount = mountTable.findContaining(canonicalRootPaths[root.root]);
+      root.mountsBelow = mountTable.hasMountsBelow(canonicalRootPaths[root.root]);
+      rootDevices[root.root] = root.mount >= 0 ? mountTable[root.mount].device : 0;
+    }
+
+    for (size_t i = 0; i < mountTable.size(); ++i) {
+      const Mount &mount = mountTable[i];
+      std::unique_ptr<MountState> mountState(new MountState);
+      auto mountLimit = mountLimits.find(mount.fileSystemType);
+      if (mountLimit != mountLimits.end()) {
+        mountState->timeoutMS = mountLimit->second.timeoutMS;
+        if (mountLimit->second.concurrency) {
+          std::unique_ptr<MountLimiter> &limiter = mountLimiters[mount.fileSystemType];
+          if (!limiter) {
+            limiter.reset(new MountLimiter(mountLimit->second.concurrency));
+          }
+          mountState->limiter = limiter.get();
+        }
+      }
+
+      mountStates.push_back(std::move(mountState));
+    }
+
+    std::vector<std::string> probePaths;
+    std::vector<std::uint32_t> probeTimeoutsMS;
+    std::vector<size_t> probedMounts;
+    for (size_t i = 0; i < mountTable.size(); ++i) {
+      if (!mountStates[i]->timeoutMS) {
+        continue;
+      }
+
+      const Mount &mount = mountTable[i];
+      for (std::uint32_t root = 0; root < paths.size(); ++root) {
+        const std::string &rootPath = canonicalRootPaths[root];
+        const std::string rootPrefix = rootPath == "/" ? "/" : rootPath + "/";
+        if (!rootPath.empty() && mount.path.compare(0, rootPrefix.size(), rootPrefix) == 0 && ShouldEnterMount(i, root)) {
+          probePaths.push_back(mount.path);
+          probeTimeoutsMS.push_back(mountStates[i]->timeoutMS);
+          probedMounts.push_back(i);
+          break;
+        }
+      }
+    }
+
+    const std::vector<bool> answered = probeMounts(probePaths, probeTimeoutsMS);
+    for (size_t i = 0; i < probedMounts.size(); ++i) {
+      if (!answered[i]) {
+        mountStates[probedMounts[i]]->unresponsive = true;
+        ++threadStats[0].mountsTimedOut;
+      }
+    }
+  }
+
+  bool ShouldEnterMount(size_t mountIndex, std::uint32_t root) {
+    const Mount &mount = mountTable[mountIndex];
+    return !skipFileSystemTypes.count(mount.fileSystemType)
+      && !(skipPseudoFileSystems && MountTable::isPseudoFileSystem(mount.fileSystemType))
+      && (!oneFileSystem || mount.device == rootDevices[root])
+      && !mountStates[mountIndex]->unresponsive;
+  }
+
+  // Returns false when the directory is not scanned now: either its mount stopped answering, or the limit
+  // of its file system type is reached and it waits for a directory of that type to be done.
+  bool EnterMount(PendingDirectory &directory, MountState &mountState) {
+    if (mountState.unresponsive) {
+      --pendingDirectories;
+      return false;
+    }
+
+    if (!mountState.limiter) {
+      return true;
+    }
+
+    std::lock_guard<std::mutex> lock(mountState.limiter->mutex);
+    if (mountState.limiter->active < mountState.limiter->concurrency) {
+      ++mountState.limiter->active;
+      return true;
+    }
+
+    // Still pending, so the traversal does not end while it waits.
+    frontierMemoryUsage += directory.memoryUsage();
+    mountState.limiter->deferred.push_back(std::move(directory));
+    return false;
+  }
+
+  void LeaveMount(
+    std::uint32_t threadIndex,
+    MountState &mountState,
+    std::uint64_t scanStartNS,
+    std::vector<PendingDirectory> &subdirectories
+  ) {
+    if (mountState.timeoutMS && wallTimeNS() - scanStartNS > (std::uint64_t)mountState.timeoutMS * 1000000) {
+      if (!mountState.unresponsive.exchange(true)) {
+        ++threadStats[threadIndex].mountsTimedOut;
+      }
+      subdirectories.clear();
+    }
+
+    if (!mountState.limiter) {
+      return;
+    }
+
+    PendingDirectory deferredDirectory;
+    {
+      std::lock_guard<std::mutex> lock(mountState.limiter->mutex);
+      --mountState.limiter->active;
+      if (mountState.limiter->deferred.empty()) {
+        return;
+      }
+      deferredDirectory = std::move(mountState.limiter->deferred.front());
+      mountState.limiter->deferred.pop_front();
+    }
+
+    workQueues[threadIndex]->push(std::move(deferredDirectory));
+    if (idleThreads > 0) {
+      idleCondition.notify_all();
+    }
+  }
+
+  // Children stay on the mount of their parent, unless the parent has mount points below it. Only then is
+  // the path of each child built and looked up.
+  void AssignMounts(std::uint32_t threadIndex, const PendingDirectory &parent, std::vector<PendingDirectory> &subdirectories) {
+    for (auto &subdirectory : subdirectories) {
+      subdirectory.mount = parent.mount;
+    }
+
+    if (!parent.mountsBelow) {
+      return;
+    }
+
+    TraversalStats &stats = threadStats[threadIndex];
+    auto skipped = std::remove_if(subdirectories.begin(), subdirectories.end(), [this, &parent, &stats](PendingDirectory &subdirectory) {
+      const std::string subdirectoryPath = CanonicalPath(*subdirectory.directory, parent.root);
+      subdirectory.mountsBelow = mountTable.hasMountsBelow(subdirectoryPath);
+      const int mount = mountTable.findAt(subdirectoryPath);
+      if (mount < 0) {
+        return false;
+      }
+
+      subdirectory.mount = mount;
+      if (ShouldEnterMount(mount, parent.root)) {
+        return false;
+      }
+
+      ++stats.mountsSkipped;
+      return true;
+    });
+    subdirectories.erase(skipped, subdirectories.end());
+  }
+
+  // Mount points are canonical paths, while the traversal builds paths from the root as it was passed.
+  std::string CanonicalPath(const DirectoryNode &directory, std::uint32_t root) {
+    const std::string directoryPath = directory.path();
+    const std::string &rootPath = canonicalRootPaths[root];
+    return (rootPath == "/" ? std::string() : rootPath) + directoryPath.substr(paths[root].size());
+  }
+  #endif
+
+  void ReportRepository(std::uint32_t threadIndex, const std::string &record) {
+    sink.repositoryFound(threadIndex, record);
+
+    ++threadStats[threadIndex].repositoriesFound;
+    if (firstRepositoryNS < 0) {
+      std::int64_t noRepository = -1;
+      firstRepositoryNS.compare_exchange_strong(noRepository, (std::int64_t)(wallTimeNS() - scanStartNS));
+    }
+    sink.heartbeat();
+  }
+
+  void CountEntry(TraversalStats &stats) {
+    if (++stats.entriesRead % kEntriesPerHeartbeat == 0) {
+      sink.heartbeat();
+    }
+  }
+
+  // Reports the repository held by a directory. Without classify only .git directories get here, and
+  // the .git path is reported as it always was. With it, the few files of the layout are read through
+  // readFile and the repository is reported as a record. Returns false if the layout did not check out.
+  bool ReportRepositoryIn(
+    std::uint32_t threadIndex,
+    RepositoryLayout layout,
+    const std::string &directoryPath,
+    char separator,
+    const ReadRepositoryFile &readFile
+  ) {
+    if (!classify) {
+      ReportRepository(threadIndex, directoryPath + separator + ".git");
+      return true;
+    }
+
+    RepositoryInfo info;
+    if (!describeRepository(layout, directoryPath, separator, readFile, readHead, info)) {
+      return false;
+    }
+
+    ReportRepository(threadIndex, encodeRepositoryInfo(info));
+    return true;
+  }
+
+  // Runs once the entries of a directory without a .git directory are known. Only classify looks for
+  // .git files and bare repositories.
+  bool ReportOtherLayouts(
+    std::uint32_t threadIndex,
+    const RepositoryEntries &entries,
+    const std::string &directoryPath,
+    char separator,
+    const ReadRepositoryFile &readFile
+  ) {
+    if (!classify || cancel) {
+      return false;
+    }
+
+    return (entries.hasGitFile() && ReportRepositoryIn(threadIndex, RepositoryLayout::GitFile, directoryPath, separator, readFile))
+      || (entries.looksBare() && ReportRepositoryIn(threadIndex, RepositoryLayout::Bare, directoryPath, separator, readFile));
+  }
+
+  #if !defined(_WIN32)
+  // Reads by full path, for directories that are not open, such as the ones replayed from the index.
+  static ReadRepositoryFile ReadFileIn(const std::string &directoryPath) {
+    return [directoryPath](const std::string &filePath, std::string &contents) {
+      std::ifstream file(filePath[0] == '/' ? filePath : directoryPath + '/' + filePath, std::ios::binary);
+      if (!file) {
+        return false;
+      }
+
+      contents.resize(kMaxRepositoryFileSize);
+      file.read(&contents[0], contents.size());
+      contents.resize((size_t)file.gcount());
+      return !file.bad();
+    };
+  }
+  #endif
+
+  #if !defined(_WIN32)
+  // Looks the directory up in the previous index. On a hit the cached outcome is replayed without reading
+  // the directory. On a miss the caller reads it and commits the new outcome to this thread's builder.
+  bool ReplayIndexedDirectory(
+    std::uint32_t threadIndex,
+    const ScanIndexKey &indexKey,
+    const PendingDirectory &currentDirectory,
+    std::vector<PendingDirectory> &subdirectories
+  ) {
+    ScanIndexBuilder &indexBuilder = indexBuilders[threadIndex];
+    indexBuilder.begin();
+
+    const ScanIndexRecord *record = previousIndex->find(indexKey);
+    if (!record) {
+      return false;
+    }
+
+    const char *names = previousIndex->names(*record);
+    indexBuilder.copy(*record, names);
+    ++threadStats[threadIndex].directoriesFromIndex;
+
+    if (record->outcome == (std::uint32_t)DirectoryOutcome::Repository) {
+      #if defined(__linux__)
+      const std::string directoryPath = currentDirectory.directory->path();
+      #else
+      const std::string directoryPath = currentDirectory.directory->path('/');
+      #endif
+      // Only repositories with a .git directory are indexed, see the ScanNativeDirectory variants.
+      ReportRepositoryIn(threadIndex, RepositoryLayout::GitDirectory, directoryPath, '/', ReadFileIn(directoryPath));
+      return true;
+    }
+
+    // The index does not depend on the exclusion rules of the search that wrote it, so they are applied here.
+    for (const char *name = names, *end = names + record->namesLength; name < end; name += strlen(name) + 1) {
+      PathMatcher::State matchState;
+      if (pathMatcher.isExcluded(currentDirectory.matchState, name, matchState)) {
+        continue;
+      }
+
+      subdirectories.push_back({ std::make_shared<DirectoryNode>(currentDirectory.directory, name), currentDirectory.depth + 1, matchState });
+    }
+    return true;
+  }
+
+  void CommitIndexedDirectory(
+    std::uint32_t threadIndex,
+    const ScanIndexKey &indexKey,
+    const PendingDirectory &currentDirectory,
+    bool isGitRepo
+  ) {
+    if (cancel || indexKey.mtimeSeconds >= indexMtimeLimit) {
+      return;
+    }
+
+    DirectoryOutcome outcome = isGitRepo
+      ? DirectoryOutcome::Repository
+      : (ShouldDescend(currentDirectory) ? DirectoryOutcome::Descended : DirectoryOutcome::Pruned);
+    indexBuilders[threadIndex].commit(indexKey, outcome);
+  }
+  #endif
+
+  void ScanDirectory(std::uint32_t threadIndex, const PendingDirectory &currentDirectory, std::vector<PendingDirectory> &subdirectories) {
+    if (fileSystem) {
+      ScanProvidedDirectory(threadIndex, currentDirectory, subdirectories);
+    } else {
+      ScanNativeDirectory(threadIndex, currentDirectory, subdirectories);
+    }
+  }
+
+  // Reads a directory through the provider of the search. What the native variants do with the index, the
+  // mounts and the page cache has no meaning here, the rest is the same.
+  void ScanProvidedDirectory(std::uint32_t threadIndex, const PendingDirectory &currentDirectory, std::vector<PendingDirectory> &subdirectories) {
+    #if defined(_WIN32)
+    const char separator = '\\';
+    #else
+    const char separator = '/';
+    #endif
+    const std::string currentPath = ReportedPath(*currentDirectory.directory, currentDirectory.root);
+
+    if (deduplicate) {
+      EntryStatus status;
+      if (
+        fileSystem->status(currentPath, currentDirectory.depth == 0, status) != 0
+        || !ClaimDirectory(threadIndex, status.device, status.inode)
+      ) {
+        return;
+      }
+    }
+
+    const ReadRepositoryFile readFile = [this, &currentPath, separator](const std::string &filePath, std::string &contents) {
+      const bool absolute = !filePath.empty()
+        && (filePath[0] == '/' || filePath[0] == '\\' || (filePath.size() > 1 && filePath[1] == ':'));
+      return fileSystem->readFile(absolute ? filePath : currentPath + separator + filePath, contents, kMaxRepositoryFileSize);
+    };
+    RepositoryEntries repositoryEntries;
+
+    bool isGitRepo = false;
+    const auto addDirectory = [&](const char *name) {
+      if (strcmp(name, ".git")) {
+        PathMatcher::State matchState;
+        if (!pathMatcher.isExcluded(currentDirectory.matchState, name, matchState)) {
+          #if defined(_WIN32)
+          auto subdirectory = std::make_shared<DirectoryNode>(currentDirectory.directory, convertMultiByteToWideChar(name));
+          #else
+          auto subdirectory = std::make_shared<DirectoryNode>(currentDirectory.directory, name);
+          #endif
+          subdirectories.push_back({ std::move(subdirectory), currentDirectory.depth + 1, matchState });
+        }
+        return;
+      }
+
+      isGitRepo = true;
+      subdirectories.clear();
+      ReportRepositoryIn(threadIndex, RepositoryLayout::GitDirectory, currentPath, separator, readFile);
+    };
+
+    // Entries of unknown type are looked up once the directory is read, like the native variants do.
+    thread_local std::vector<std::string> unknownEntries;
+    unknownEntries.clear();
+
+    TraversalStats &stats = threadStats[threadIndex];
+    const int error = fileSystem->listDirectory(currentPath, [&](const char *name, EntryType type) {
+      CountEntry(stats);
+
+      if (classify) {
+        repositoryEntries.add(name, type == EntryType::Directory);
+      }
+
+      if (type == EntryType::Unknown) {
+        ++stats.statFallbacks;
+        unknownEntries.push_back(name);
+      } else if (type == EntryType::Directory) {
+        addDirectory(name);
+      }
+      return !cancel && !isGitRepo;
+    });
+    if (error) {
+      stats.recordFailedOpen(error);
+      return;
+    }
+    ++stats.directoriesOpened;
+    ++stats.directoryReads;
+
+    for (size_t i = 0; i < unknownEntries.size() && !cancel && !isGitRepo; ++i) {
+      EntryStatus status;
+      if (fileSystem->status(currentPath + separator + unknownEntries[i], false, status) == 0 && status.isDirectory) {
+        addDirectory(unknownEntries[i].c_str());
+      }
+    }
+
+    if (!isGitRepo && ReportOtherLayouts(threadIndex, repositoryEntries, currentPath, separator, readFile)) {
+      subdirectories.clear();
+    }
+  }
+
+  #if defined(_WIN32)
+  void ScanNativeDirectory(std::uint32_t threadIndex, const PendingDirectory &currentDirectory, std::vector<PendingDirectory> &subdirectories) {
+    const std::wstring currentPath = currentDirectory.directory->path(L'\\');
+    std::uint64_t volume, fileIndex;
+    if (
+      deduplicate
+      && getFileId(currentPath, currentDirectory.depth == 0, &volume, &fileIndex)
+      && !ClaimDirectory(threadIndex, volume, fileIndex)
+    ) {
+      return;
+    }
+
+    const std::wstring gitPath = L".git";
+    const std::wstring dot = L".";
+    const std::wstring dotdot = L"..";
+
+    WIN32_FIND_DATAW FindFileData;
+    std::wstring wildcardPath = currentPath + L"\\*";
+    TraversalStats &stats = threadStats[threadIndex];
+    HANDLE hFind = FindFirstFileW(wildcardPath.c_str(), &FindFileData);
+    if (hFind == INVALID_HANDLE_VALUE) {
+      stats.recordFailedOpen((int)GetLastError());
+      return;
+    }
+    ++stats.directoriesOpened;
+
+    const ReadRepositoryFile readFile = [&currentPath](const std::string &filePath, std::string &contents) {
+      // Git writes forward slashes, which long paths do not accept.
+      std::wstring wideFilePath = convertMultiByteToWideChar(filePath);
+      std::replace(wideFilePath.begin(), wideFilePath.end(), L'/', L'\\');
+      if (!(wideFilePath.size() > 1 && wideFilePath[1] == L':') && wideFilePath.compare(0, 2, L"\\\\") != 0) {
+        wideFilePath = currentPath + L"\\" + wideFilePath;
+      }
+      return readSmallFile(wideFilePath, &contents, (DWORD)kMaxRepositoryFileSize);
+    };
+    RepositoryEntries repositoryEntries;
+    bool isGitRepo = false;
+
+    // FindNextFileW tells an error from the end of the directory only through GetLastError.
+    DWORD readError = ERROR_NO_MORE_FILES;
+    const auto nextEntry = [&]() {
+      if (FindNextFileW(hFind, &FindFileData)) {
+        return true;
+      }
+      readError = GetLastError();
+      return false;
+    };
+
+    do {
+      CountEntry(stats);
+
+      if (dot == FindFileData.cFileName || dotdot == FindFileData.cFileName) {
+        continue;
+      }
+
+      const bool isDirectory = (FindFileData.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) == FILE_ATTRIBUTE_DIRECTORY;
+      if (classify && !isDirectory) {
+        std::string name;
+        if (convertWideCharToMultiByte(&name, FindFileData.cFileName, true)) {
+          repositoryEntries.add(name.c_str(), false);
+        }
+      }
+
+      if (!isDirectory) {
+        continue;
+      }
+
+      if (gitPath == FindFileData.cFileName) {
+        isGitRepo = true;
+        subdirectories.clear();
+
+        std::string repoPath;
+        int success = convertWideCharToMultiByte(&repoPath, currentPath, wasNtPath[currentDirectory.root]);
+        if (success) {
+          ReportRepositoryIn(threadIndex, RepositoryLayout::GitDirectory, repoPath, '\\', readFile);
+        }
+        break;
+      }
+
+      if (classify) {
+        std::string name;
+        if (convertWideCharToMultiByte(&name, FindFileData.cFileName, true)) {
+          repositoryEntries.add(name.c_str(), true);
+        }
+      }
+
+      PathMatcher::State matchState = 0;
+      if (!pathMatcher.empty()) {
+        std::string name;
+        if (
+          !convertWideCharToMultiByte(&name, FindFileData.cFileName, true)
+          || pathMatcher.isExcluded(currentDirectory.matchState, name.c_str(), matchState)
+        ) {
+          continue;
+        }
+      }
+
+      subdirectories.push_back({ std::make_shared<DirectoryNode>(currentDirectory.directory, FindFileData.cFileName), currentDirectory.depth + 1, matchState });
+    } while (!cancel && nextEntry());
+
+    FindClose(hFind);
+    if (readError != ERROR_NO_MORE_FILES) {
+      stats.recordFailedRead((int)readError);
+    }
+
+    std::string directoryPath;
+    if (
+      !isGitRepo
+      && classify
+      && convertWideCharToMultiByte(&directoryPath, currentPath, wasNtPath[currentDirectory.root])
+      && ReportOtherLayouts(threadIndex, repositoryEntries, directoryPath, '\\', readFile)
+    ) {
+      subdirectories.clear();
+    }
+  }
+  #elif defined(__linux__)
+  void ScanNativeDirectory(std::uint32_t threadIndex, const PendingDirectory &currentDirectory, std::vector<PendingDirectory> &subdirectories) {
+    thread_local DirectoryReader directoryReader;
+    const std::shared_ptr<DirectoryNode> &directory = currentDirectory.directory;
+
+    ScanIndexKey indexKey;
+    const bool useIndex = !indexBuilders.empty();
+    if (useIndex || deduplicate) {
+      struct stat statBuffer;
+      if (directory->status(&statBuffer) < 0) {
+        return;
+      }
+
+      if (deduplicate && !ClaimDirectory(threadIndex, statBuffer.st_dev, statBuffer.st_ino)) {
+        return;
+      }
+
+      indexKey = { (std::uint64_t)statBuffer.st_dev, (std::uint64_t)statBuffer.st_ino, statBuffer.st_mtim.tv_sec, (std::uint32_t)statBuffer.st_mtim.tv_nsec };
+      if (useIndex && ReplayIndexedDirectory(threadIndex, indexKey, currentDirectory, subdirectories)) {
+        return;
+      }
+    }
+
+    TraversalStats &stats = threadStats[threadIndex];
+    const int descriptor = directory->openDescriptor(cacheHints);
+    if (descriptor < 0) {
+      stats.recordFailedOpen(errno);
+      return;
+    }
+    ++stats.directoriesOpened;
+
+    const ReadRepositoryFile readFile = [descriptor, cacheHints = cacheHints](const std::string &filePath, std::string &contents) {
+      return readFileAt(descriptor, filePath, contents, kMaxRepositoryFileSize, cacheHints);
+    };
+    RepositoryEntries repositoryEntries;
+
+    bool isGitRepo = false;
+    const auto addDirectory = [&](const char *name) {
+      if (strcmp(name, ".git")) {
+        if (useIndex) {
+          indexBuilders[threadIndex].addName(name);
+        }
+
+        PathMatcher::State matchState;
+        if (!pathMatcher.isExcluded(currentDirectory.matchState, name, matchState)) {
+          subdirectories.push_back({ std::make_shared<DirectoryNode>(directory, name), currentDirectory.depth + 1, matchState });
+        }
+        return;
+      }
+
+      isGitRepo = true;
+      subdirectories.clear();
+      ReportRepositoryIn(threadIndex, RepositoryLayout::GitDirectory, directory->path(), '/', readFile);
+    };
+
+    // Entries of unknown type are looked up together once the directory is read.
+    thread_local StatBatch unknownEntries;
+    unknownEntries.clear();
+
+    const char *name;
+    unsigned char type;
+    directoryReader.reset(descriptor);
+    while (!cancel && !isGitRepo && directoryReader.next(name, type)) {
+      CountEntry(stats);
+
+      if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        continue;
+      }
+
+      if (classify) {
+        repositoryEntries.add(name, type == DT_DIR);
+      }
+
+      if (type == DT_UNKNOWN) {
+        ++stats.statFallbacks;
+        unknownEntries.add(name);
+      } else if (type == DT_DIR) {
+        addDirectory(name);
+      }
+    }
+
+    if (!cancel && !isGitRepo && unknownEntries.size() > 0) {
+      if (background) {
+        unknownEntries.resolveInThisThread(descriptor);
+      } else {
+        unknownEntries.resolve(descriptor);
+      }
+      for (size_t i = 0; i < unknownEntries.size() && !isGitRepo; ++i) {
+        if (unknownEntries.isDirectory(i)) {
+          addDirectory(unknownEntries.name(i));
+        }
+      }
+    }
+
+    // Repositories with a .git file or bare ones are never indexed, their files are read on every search.
+    bool isOtherRepo = false;
+    if (!isGitRepo && ReportOtherLayouts(threadIndex, repositoryEntries, directory->path(), '/', readFile)) {
+      isOtherRepo = true;
+      subdirectories.clear();
+    }
+
+    stats.directoryReads += directoryReader.numReads();
+    // The entries read before the error are still searched, but the directory is not indexed as complete.
+    const bool readFailed = directoryReader.error() != 0;
+    if (readFailed) {
+      stats.recordFailedRead(directoryReader.error());
+    }
+    // Only reaches the pages the file system keeps for the directory itself, not the dentry cache.
+    if (cacheHints) {
+      posix_fadvise(descriptor, 0, 0, POSIX_FADV_DONTNEED);
+    }
+    directory->releaseDescriptor(!subdirectories.empty());
+
+    if (useIndex && !isOtherRepo && !readFailed) {
+      CommitIndexedDirectory(threadIndex, indexKey, currentDirectory, isGitRepo);
+    }
+  }
+  #else
+  void ScanNativeDirectory(std::uint32_t threadIndex, const PendingDirectory &currentDirectory, std::vector<PendingDirectory> &subdirectories) {
+    const std::string currentPath = currentDirectory.directory->path('/');
+
+    ScanIndexKey indexKey;
+    const bool useIndex = !indexBuilders.empty();
+    if (useIndex || deduplicate) {
+      // The root may be a symlink to the directory to search, anything below it is never followed.
+      struct stat statBuffer;
+      const int result = currentDirectory.depth == 0
+        ? stat(currentPath.c_str(), &statBuffer)
+        : lstat(currentPath.c_str(), &statBuffer);
+      if (result < 0) {
+        return;
+      }
+
+      if (deduplicate && !ClaimDirectory(threadIndex, statBuffer.st_dev, statBuffer.st_ino)) {
+        return;
+      }
+
+      #if defined(__APPLE__)
+      const struct timespec &modified = statBuffer.st_mtimespec;
+      #else
+      const struct timespec &modified = statBuffer.st_mtim;
+      #endif
+      indexKey = { (std::uint64_t)statBuffer.st_dev, (std::uint64_t)statBuffer.st_ino, (std::int64_t)modified.tv_sec, (std::uint32_t)modified.tv_nsec };
+      if (useIndex && ReplayIndexedDirectory(threadIndex, indexKey, currentDirectory, subdirectories)) {
+        return;
+      }
+    }
+
+    bool isGitRepo = false;
+
+    TraversalStats &stats = threadStats[threadIndex];
+    DIR *directory = opendir((currentPath + '/').c_str());
+    if (!directory) {
+      stats.recordFailedOpen(errno);
+      return;
+    }
+    ++stats.directoriesOpened;
+    ++stats.directoryReads;
+
+    RepositoryEntries repositoryEntries;
+    // readdir tells an error from the end of the directory only through errno.
+    int readError = 0;
+    const auto nextEntry = [directory, &readError]() {
+      errno = 0;
+      const struct dirent *entry = readdir(directory);
+      readError = entry ? 0 : errno;
+      return entry;
+    };
+    const struct dirent *directoryEntry;
+    while (!cancel && (directoryEntry = nextEntry())) {
+      const char *name = directoryEntry->d_name;
+      if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+        continue;
+      }
+
+      CountEntry(stats);
+      std::string nextPath = currentPath + '/' + name;
+
+      if (classify) {
+        repositoryEntries.add(name, directoryEntry->d_type == DT_DIR);
+      }
+
+      if (directoryEntry->d_type == DT_UNKNOWN) {
+        ++stats.statFallbacks;
+        struct stat statBuffer;
+        if (lstat(nextPath.c_str(), &statBuffer) < 0 || !S_ISDIR(statBuffer.st_mode)) {
+          continue;
+        }
+      } else if (directoryEntry->d_type != DT_DIR) {
+        continue;
+      }
+
+      if (strcmp(name, ".git")) {
+        if (useIndex) {
+          indexBuilders[threadIndex].addName(name);
+        }
+
+        PathMatcher::State matchState;
+        if (!pathMatcher.isExcluded(currentDirectory.matchState, name, matchState)) {
+          subdirectories.push_back({ std::make_shared<DirectoryNode>(currentDirectory.directory, name), currentDirectory.depth + 1, matchState });
+        }
+        continue;
+      }
+
+      isGitRepo = true;
+      subdirectories.clear();
+      ReportRepositoryIn(threadIndex, RepositoryLayout::GitDirectory, currentPath, '/', ReadFileIn(currentPath));
+      break;
+    }
+
+    closedir(directory);
+    // The entries read before the error are still searched, but the directory is not indexed as complete.
+    if (readError) {
+      stats.recordFailedRead(readError);
+    }
+
+    bool isOtherRepo = false;
+    if (!isGitRepo && ReportOtherLayouts(threadIndex, repositoryEntries, currentPath, '/', ReadFileIn(currentPath))) {
+      isOtherRepo = true;
+      subdirectories.clear();
+    }
+
+    if (useIndex && !isOtherRepo && !readError) {
+      CommitIndexedDirectory(threadIndex, indexKey, currentDirectory, isGitRepo);
+    }
+  }
+  #endif
+
+  ScanSummary summary;
+
+private:
+  std::vector<std::string> paths;
+  // Only a search over several roots can reach a directory twice, it is the only one paying for a
+  // lookup of every directory in the visited set.
+  const bool deduplicate;
+  VisitedSet visited;
+  ScanSink &sink;
+  std::uint32_t maxSubfolderDeep;
+  std::uint32_t concurrency;
+  size_t frontierMemoryLimit;
+  const std::shared_ptr<FileSystemProvider> fileSystem;
+  std::string indexPath;
+  const std::string subtreeOf;
+  const bool reportDirectories;
+  const PathMatcher pathMatcher;
+  std::uint32_t latencySampleInterval;
+  const bool classify;
+  const bool readHead;
+  const bool prioritize;
+  const DirectoryRanker ranker;
+  // 0 when there is no deadline, or no limit to the number of directories.
+  const std::uint64_t deadlineNS;
+  const std::uint32_t maxDirectories;
+  const bool background;
+  // Null when directories are read as fast as they come.
+  const std::unique_ptr<RateLimiter> rateLimiter;
+  std::atomic<std::uint32_t> threadsWithLowerIoPriority;
+  std::atomic<std::uint32_t> threadsWithLowerCpuPriority;
+  #if defined(__linux__)
+  const bool oneFileSystem;
+  const bool skipPseudoFileSystems;
+  const std::set<std::string> skipFileSystemTypes;
+  const std::map<std::string, MountLimit> mountLimits;
+  bool mountAware;
+  MountTable mountTable;
+  std::vector<std::string> canonicalRootPaths;
+  std::vector<std::uint64_t> rootDevices;
+  std::map<std::string, std::unique_ptr<MountLimiter>> mountLimiters;
+  std::vector<std::unique_ptr<MountState>> mountStates;
+  const bool cacheHints;
+  #endif
+  #if defined(_WIN32)
+  std::vector<bool> wasNtPath;
+  #else
+  std::unique_ptr<ScanIndex> previousIndex;
+  std::vector<ScanIndexBuilder> indexBuilders;
+  std::int64_t indexMtimeLimit;
+  #endif
+  std::vector<std::unique_ptr<Frontier<PendingDirectory>>> workQueues;
+  std::atomic<size_t> pendingDirectories;
+  std::atomic<size_t> frontierMemoryUsage;
+  std::atomic<bool> depthFirst;
+  std::atomic<int> idleThreads;
+  std::mutex idleMutex;
+  std::condition_variable idleCondition;
+  std::vector<TraversalStats> threadStats;
+  PhaseTimer setupPhase;
+  PhaseTimer traversalPhase;
+  PhaseTimer indexWritePhase;
+  std::uint64_t scanStartNS;
+  std::atomic<std::int64_t> firstRepositoryNS;
+  std::atomic<std::uint32_t> directoriesTaken;
+  // Set once the deadline passed or maxDirectories were taken. The search then ends like a cancelled one,
+  // but its results and index are kept, and directoriesLeft tells how many directories it did not read.
+  std::atomic<bool> overBudget;
+  size_t directoriesLeft;
+  std::atomic<bool> &cancel;
+};
+
+RepositoryScanner::RepositoryScanner(
+  std::vector<std::string> paths,
+  const SearchOptions &searchOptions,
+  ScanSink &sink,
+  std::atomic<bool> &cancel
+):
+  mTraversal(new Traversal(std::move(paths), searchOptions, sink, cancel))
+{}
+
+RepositoryScanner::~RepositoryScanner() {}
+
+void RepositoryScanner::run() {
+  mTraversal->run();
+}
+
+const ScanSummary &RepositoryScanner::summary() const {
+  return mTraversal->summary;
+}
@@ -0,0 +1,357 @@
+#include "../includes/RepositoryWatcher.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <errno.h>
+#include <limits>
+#include <mutex>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  const std::uint32_t kWatchMask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO
+    | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR | IN_EXCL_UNLINK;
+
+  bool hasPrefix(const std::string &path, const std::string &prefix) {
+    return path.compare(0, prefix.size(), prefix) == 0;
+  }
+}
+
+// Collects what a scan finds, and watches every directory the scan enters before it is read, so nothing
+// created while it is being read can be missed. Below a directory that could not get a watch, nothing is
+// watched, the whole subtree is polled. The traversal threads call in concurrently, while the watcher
+// thread waits for the scan.
+class RepositoryWatcher::ScanRecorder : public ScanSink {
+public:
+  ScanRecorder(RepositoryWatcher &watcher, std::set<std::string> &repositories):
+    mWatcher(watcher),
+    mRepositories(repositories)
+  {}
+
+  void repositoryFound(std::uint32_t threadIndex, const std::string &record) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mRepositories.insert(record);
+  }
+
+  bool wantsDirectories() const override {
+    return true;
+  }
+
+  void directoryEntered(std::uint32_t threadIndex, const std::string &path) override {
+    std::lock_guard<std::mutex> lock(mMutex);
+    if (isInUnwatchedSubtree(path)) {
+      return;
+    }
+
+    if (!mWatcher.addWatch(path)) {
+      mWatcher.mUnwatchedSubtrees.insert(path);
+    }
+  }
+
+private:
+  bool isInUnwatchedSubtree(const std::string &path) const {
+    const std::set<std::string> &unwatchedSubtrees = mWatcher.mUnwatchedSubtrees;
+    if (unwatchedSubtrees.empty()) {
+      return false;
+    }
+
+    for (size_t separator = path.find('/', mWatcher.mRootPath.size()); separator != std::string::npos; separator = path.find('/', separator + 1)) {
+      if (unwatchedSubtrees.count(path.substr(0, separator))) {
+        return true;
+      }
+    }
+    return unwatchedSubtrees.count(path) > 0;
+  }
+
+  RepositoryWatcher &mWatcher;
+  std::set<std::string> &mRepositories;
+  std::mutex mMutex;
+};
+
+RepositoryWatcher::RepositoryWatcher(
+  std::string rootPath,
+  const SearchOptions &searchOptions,
+  std::uint32_t maxWatches,
+  std::uint32_t pollIntervalMS,
+  EventCallback eventCallback
+):
+  mRootPath(rootPath),
+  mSearchOptions(searchOptions),
+  mRescanOptions(searchOptions),
+  mMaxWatches(maxWatches),
+  mPollIntervalMS(pollIntervalMS),
+  mEventCallback(eventCallback),
+  mInotifyDescriptor(-1),
+  mStopDescriptor(-1),
+  mStopping(false)
+{
+  // A rescan only covers a subtree, the index it would write would lose the rest of the tree.
+  mRescanOptions.indexPath.clear();
+  mRescanOptions.subtreeOf = mRootPath;
+}
+
+RepositoryWatcher::~RepositoryWatcher() {
+  stop();
+
+  if (mInotifyDescriptor >= 0) {
+    close(mInotifyDescriptor);
+  }
+
+  if (mStopDescriptor >= 0) {
+    close(mStopDescriptor);
+  }
+}
+
+bool RepositoryWatcher::start() {
+  mInotifyDescriptor = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+  mStopDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (mInotifyDescriptor < 0 || mStopDescriptor < 0) {
+    return false;
+  }
+
+  mThread = std::thread([this]() { run(); });
+  return true;
+}
+
+void RepositoryWatcher::stop() {
+  if (!mThread.joinable()) {
+    return;
+  }
+
+  mStopping = true;
+  std::uint64_t value = 1;
+  if (write(mStopDescriptor, &value, sizeof(value)) < 0) {
+    // The watcher thread also checks mStopping between directories, the wake up only shortens the wait.
+  }
+  mThread.join();
+}
+
+void RepositoryWatcher::run() {
+  std::set<std::string> repositories;
+  scanSubtree(mRootPath, mSearchOptions, repositories);
+  for (const auto &repository : repositories) {
+    mRepositories.insert(repository);
+    emit(RepositoryEvent::Added, repository);
+  }
+  flush();
+
+  alignas(struct inotify_event) char buffer[64 * 1024];
+  auto lastPollTimePoint = std::chrono::steady_clock::now();
+  const std::chrono::milliseconds pollInterval(mPollIntervalMS);
+
+  while (!mStopping) {
+    struct pollfd descriptors[2] = {
+      { mInotifyDescriptor, POLLIN, 0 },
+      { mStopDescriptor, POLLIN, 0 }
+    };
+    // Clamped, an interval above INT_MAX would turn negative and poll() would wait forever.
+    const int timeout = mUnwatchedSubtrees.empty() || !mPollIntervalMS
+      ? -1
+      : (int)std::min<std::uint32_t>(mPollIntervalMS, std::numeric_limits<int>::max());
+    const int ready = poll(descriptors, 2, timeout);
+    if (ready < 0 && errno != EINTR) {
+      break;
+    }
+
+    if (mStopping) {
+      break;
+    }
+
+    if (ready > 0 && (descriptors[0].revents & POLLIN)) {
+      ssize_t length;
+      while ((length = read(mInotifyDescriptor, buffer, sizeof(buffer))) > 0) {
+        for (char *cursor = buffer; cursor < buffer + length && !mStopping;) {
+          const struct inotify_event *event = reinterpret_cast<const struct inotify_event *>(cursor);
+          handleEvent(event->mask, event->wd, event->len ? event->name : nullptr);
+          cursor += sizeof(struct inotify_event) + event->len;
+        }
+      }
+    }
+
+    // Subtrees without watches are polled, whether or not inotify kept the thread busy in the meantime.
+    const auto now = std::chrono::steady_clock::now();
+    if (!mUnwatchedSubtrees.empty() && mPollIntervalMS && now - lastPollTimePoint >= pollInterval) {
+      const std::set<std::string> unwatchedSubtrees = mUnwatchedSubtrees;
+      for (const auto &subtree : unwatchedSubtrees) {
+        if (!mStopping && mUnwatchedSubtrees.count(subtree)) {
+          rescanSubtree(subtree);
+        }
+      }
+      lastPollTimePoint = now;
+    }
+
+    flush();
+  }
+}
+
+void RepositoryWatcher::handleEvent(std::uint32_t mask, int watchDescriptor, const char *name) {
+  if (mask & IN_Q_OVERFLOW) {
+    rescanSubtree(mRootPath);
+    return;
+  }
+
+  auto watch = mPathsByWatch.find(watchDescriptor);
+  if (watch == mPathsByWatch.end()) {
+    return;
+  }
+
+  const std::string path = watch->second;
+  if (mask & IN_IGNORED) {
+    auto watchByPath = mWatchesByPath.find(path);
+    if (watchByPath != mWatchesByPath.end() && watchByPath->second == watchDescriptor) {
+      mWatchesByPath.erase(watchByPath);
+    }
+    mPathsByWatch.erase(watch);
+    return;
+  }
+
+  if (mask & (IN_DELETE_SELF | IN_MOVE_SELF)) {
+    if (path == mRootPath) {
+      removeSubtree(mRootPath);
+    }
+    return;
+  }
+
+  if (!(mask & IN_ISDIR) || !name) {
+    return;
+  }
+
+  // A .git directory appearing or disappearing changes what the directory itself is, so it is read again.
+  if (!strcmp(name, ".git")) {
+    rescanSubtree(path);
+    return;
+  }
+
+  if (mRepositories.count(path + "/.git")) {
+    return;
+  }
+
+  if (mSearchOptions.maxSubfolderDeep > 0 && depthOf(path) >= mSearchOptions.maxSubfolderDeep) {
+    return;
+  }
+
+  const std::string childPath = path + '/' + name;
+  if (mask & (IN_CREATE | IN_MOVED_TO)) {
+    rescanSubtree(childPath);
+  } else if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+    removeSubtree(childPath);
+  }
+}
+
+void RepositoryWatcher::rescanSubtree(const std::string &path) {
+  forgetWatches(path, true);
+
+  std::set<std::string> repositories;
+  scanSubtree(path, mRescanOptions, repositories);
+  if (mStopping) {
+    return;
+  }
+
+  const std::string prefix = path + '/';
+  for (auto repository = mRepositories.lower_bound(prefix); repository != mRepositories.end() && hasPrefix(*repository, prefix);) {
+    if (repositories.count(*repository)) {
+      ++repository;
+      continue;
+    }
+
+    emit(RepositoryEvent::Removed, *repository);
+    repository = mRepositories.erase(repository);
+  }
+
+  for (const auto &repository : repositories) {
+    if (mRepositories.insert(repository).second) {
+      emit(RepositoryEvent::Added, repository);
+    }
+  }
+}
+
+void RepositoryWatcher::removeSubtree(const std::string &path) {
+  forgetWatches(path, true);
+
+  const std::string prefix = path + '/';
+  for (auto repository = mRepositories.lower_bound(prefix); repository != mRepositories.end() && hasPrefix(*repository, prefix);) {
+    emit(RepositoryEvent::Removed, *repository);
+    repository = mRepositories.erase(repository);
+  }
+}
+
+// Below the root, a path that is no longer a directory, or is a symlink now, is not scanned, like the
+// search does not follow symlinks below its root.
+void RepositoryWatcher::scanSubtree(const std::string &path, const SearchOptions &searchOptions, std::set<std::string> &repositories) {
+  struct stat statBuffer;
+  if (path != mRootPath && (lstat(path.c_str(), &statBuffer) < 0 || !S_ISDIR(statBuffer.st_mode))) {
+    return;
+  }
+
+  ScanRecorder recorder(*this, repositories);
+  RepositoryScanner scanner({ path }, searchOptions, recorder, mStopping);
+  scanner.run();
+}
+
+void RepositoryWatcher::forgetWatches(const std::string &path, bool includeSelf) {
+  auto forget = [this](std::map<std::string, int>::iterator watch) {
+    inotify_rm_watch(mInotifyDescriptor, watch->second);
+    mPathsByWatch.erase(watch->second);
+    return mWatchesByPath.erase(watch);
+  };
+
+  if (includeSelf) {
+    auto watch = mWatchesByPath.find(path);
+    if (watch != mWatchesByPath.end()) {
+      forget(watch);
+    }
+    mUnwatchedSubtrees.erase(path);
+  }
+
+  const std::string prefix = path + '/';
+  for (auto watch = mWatchesByPath.lower_bound(prefix); watch != mWatchesByPath.end() && hasPrefix(watch->first, prefix);) {
+    watch = forget(watch);
+  }
+
+  for (auto subtree = mUnwatchedSubtrees.lower_bound(prefix); subtree != mUnwatchedSubtrees.end() && hasPrefix(*subtree, prefix);) {
+    subtree = mUnwatchedSubtrees.erase(subtree);
+  }
+}
+
+bool RepositoryWatcher::addWatch(const std::string &path) {
+  if (mWatchesByPath.size() >= mMaxWatches) {
+    return false;
+  }
+
+  const std::uint32_t mask = kWatchMask | (path == mRootPath ? 0 : IN_DONT_FOLLOW);
+  const int watchDescriptor = inotify_add_watch(mInotifyDescriptor, path.c_str(), mask);
+  if (watchDescriptor < 0) {
+    return false;
+  }
+
+  mWatchesByPath[path] = watchDescriptor;
+  mPathsByWatch[watchDescriptor] = path;
+  return true;
+}
+
+std::uint32_t RepositoryWatcher::depthOf(const std::string &path) const {
+  std::uint32_t depth = 0;
+  for (size_t i = mRootPath.size(); i < path.size(); ++i) {
+    if (path[i] == '/') {
+      ++depth;
+    }
+  }
+  return depth;
+}
+
+void RepositoryWatcher::emit(RepositoryEvent::Type type, const std::string &path) {
+  mPendingEvents.push_back({ type, path });
+}
+
+void RepositoryWatcher::flush() {
+  if (mPendingEvents.empty()) {
+    return;
+  }
+
+  mEventCallback(mPendingEvents);
+  mPendingEvents.clear();
+}
@@ -0,0 +1,62 @@
+#include "../includes/ScanCoordinator.h"
+
+#include <algorithm>
+
+void SharedScan::join(std::unique_ptr<ScanSubscriber> subscriber, std::uint32_t subscriberCacheTTLMS) {
+  subscriber->filter.filter(repositories, subscriber->unread);
+  cacheTTLMS = std::max(cacheTTLMS, subscriberCacheTTLMS);
+  subscribers.push_back(std::move(subscriber));
+}
+
+// The search did not go below the repository hiding a caller, so that caller got nothing from it yet.
+std::vector<std::unique_ptr<ScanSubscriber>> SharedScan::takeUncovered(const std::string &batch) {
+  std::vector<std::unique_ptr<ScanSubscriber>> uncovered;
+  for (auto subscriber = subscribers.begin(); subscriber != subscribers.end(); ) {
+    if (!(*subscriber)->filter.hidesRoot(batch)) {
+      ++subscriber;
+      continue;
+    }
+
+    uncovered.push_back(std::move(*subscriber));
+    subscriber = subscribers.erase(subscriber);
+  }
+  return uncovered;
+}
+
+void SharedScan::removeCancelled() {
+  auto cancelled = std::remove_if(subscribers.begin(), subscribers.end(), [](const std::unique_ptr<ScanSubscriber> &subscriber) {
+    return subscriber->cancelled;
+  });
+  subscribers.erase(cancelled, subscribers.end());
+}
+
+SharedScan *ScanCoordinator::findRunning(const ScanScope &scope, bool &exact) {
+  for (auto &sharedScan : mRunningScans) {
+    if (scopeCovers(sharedScan->scope, sharedScan->repositories, scope, exact)) {
+      return sharedScan.get();
+    }
+  }
+  return nullptr;
+}
+
+void ScanCoordinator::add(const std::shared_ptr<SharedScan> &sharedScan) {
+  mRunningScans.push_back(sharedScan);
+}
+
+void ScanCoordinator::remove(const SharedScan *sharedScan) {
+  auto running = std::find_if(mRunningScans.begin(), mRunningScans.end(), [sharedScan](const std::shared_ptr<SharedScan> &runningScan) {
+    return runningScan.get() == sharedScan;
+  });
+  if (running != mRunningScans.end()) {
+    mRunningScans.erase(running);
+  }
+}
+
+void ScanCoordinator::finish(SharedScan &sharedScan, bool cancelled) {
+  remove(&sharedScan);
+  if (!cancelled && sharedScan.cacheTTLMS) {
+    std::shared_ptr<const std::string> repositories(new std::string(std::move(sharedScan.repositories)));
+    cache.add(sharedScan.scope, repositories, sharedScan.cacheTTLMS);
+  }
+  sharedScan.repositories.clear();
+}
@@ -0,0 +1,244 @@
+#include "../includes/ScanIndex.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+  const char kScanIndexMagic[4] = { 'F', 'G', 'R', 'I' };
+  const std::uint32_t kScanIndexVersion = 1;
+
+  bool compareRecords(const ScanIndexRecord &lhs, const ScanIndexRecord &rhs) {
+    return lhs.device != rhs.device ? lhs.device < rhs.device : lhs.inode < rhs.inode;
+  }
+
+  bool writeAll(int descriptor, const void *data, size_t size) {
+    const char *bytes = static_cast<const char *>(data);
+    while (size > 0) {
+      ssize_t written = ::write(descriptor, bytes, size);
+      if (written < 0) {
+        return false;
+      }
+
+      bytes += written;
+      size -= written;
+    }
+    return true;
+  }
+}
+
+ScanIndex::ScanIndex(const std::string &indexPath, std::uint32_t requiredFlags):
+  mMapping(MAP_FAILED),
+  mMappingSize(0),
+  mRecords(nullptr),
+  mRecordCount(0),
+  mNames(nullptr)
+{
+  int descriptor = open(indexPath.c_str(), O_RDONLY | O_CLOEXEC);
+  if (descriptor < 0) {
+    return;
+  }
+
+  struct stat statBuffer;
+  if (fstat(descriptor, &statBuffer) < 0 || (size_t)statBuffer.st_size < sizeof(ScanIndexHeader)) {
+    close(descriptor);
+    return;
+  }
+
+  mMappingSize = statBuffer.st_size;
+  mMapping = mmap(nullptr, mMappingSize, PROT_READ, MAP_PRIVATE, descriptor, 0);
+  close(descriptor);
+  if (mMapping == MAP_FAILED) {
+    return;
+  }
+
+  // Anything that does not look exactly like an index of this version is treated as an empty index.
+  const ScanIndexHeader *header = static_cast<const ScanIndexHeader *>(mMapping);
+  const std::uint64_t recordsSize = header->recordCount * sizeof(ScanIndexRecord);
+  if (
+    memcmp(header->magic, kScanIndexMagic, sizeof(kScanIndexMagic))
+    || header->version != kScanIndexVersion
+    || header->recordSize != sizeof(ScanIndexRecord)
+    || (header->flags & requiredFlags) != requiredFlags
+    || header->recordCount > mMappingSize / sizeof(ScanIndexRecord)
+    || sizeof(ScanIndexHeader) + recordsSize + header->namesSize != mMappingSize
+  ) {
+    return;
+  }
+
+  mRecords = reinterpret_cast<const ScanIndexRecord *>(static_cast<const char *>(mMapping) + sizeof(ScanIndexHeader));
+  mRecordCount = header->recordCount;
+  mNames = reinterpret_cast<const char *>(mRecords + mRecordCount);
+  if (!isValid(header->namesSize)) {
+    mRecords = nullptr;
+    mRecordCount = 0;
+    mNames = nullptr;
+  }
+}
+
+// The header matching the size of the file does not make the rest of it sound: a file left behind by a
+// crash or written over by something else may hold anything. Every record has to be in order and point at
+// names within the file, each a single NUL terminated path component, before any of them is trusted.
+bool ScanIndex::isValid(std::uint64_t namesSize) const {
+  for (std::uint64_t i = 0; i < mRecordCount; ++i) {
+    const ScanIndexRecord &record = mRecords[i];
+    if (
+      (i > 0 && !compareRecords(mRecords[i - 1], record))
+      || record.outcome > (std::uint32_t)DirectoryOutcome::Pruned
+      || record.namesOffset > namesSize
+      || record.namesLength > namesSize - record.namesOffset
+      || (record.namesLength > 0 && mNames[record.namesOffset + record.namesLength - 1] != '\0')
+    ) {
+      return false;
+    }
+
+    const char *name = mNames + record.namesOffset;
+    const char *end = name + record.namesLength;
+    while (name < end) {
+      const size_t length = strlen(name);
+      if (
+        length == 0
+        || memchr(name, '/', length)
+        || (name[0] == '.' && (length == 1 || (length == 2 && name[1] == '.')))
+      ) {
+        return false;
+      }
+      name += length + 1;
+    }
+  }
+  return true;
+}
+
+ScanIndex::~ScanIndex() {
+  if (mMapping != MAP_FAILED) {
+    munmap(mMapping, mMappingSize);
+  }
+}
+
+const ScanIndexRecord *ScanIndex::find(const ScanIndexKey &key) const {
+  if (!mRecordCount) {
+    return nullptr;
+  }
+
+  ScanIndexRecord needle;
+  needle.device = key.device;
+  needle.inode = key.inode;
+
+  const ScanIndexRecord *end = mRecords + mRecordCount;
+  const ScanIndexRecord *record = std::lower_bound(mRecords, end, needle, compareRecords);
+  if (
+    record == end
+    || record->device != key.device
+    || record->inode != key.inode
+    || record->mtimeSeconds != key.mtimeSeconds
+    || record->mtimeNanoseconds != key.mtimeNanoseconds
+  ) {
+    return nullptr;
+  }
+
+  return record;
+}
+
+const char *ScanIndex::names(const ScanIndexRecord &record) const {
+  return mNames + record.namesOffset;
+}
+
+ScanIndexBuilder::ScanIndexBuilder():
+  mCommittedNamesSize(0)
+{}
+
+void ScanIndexBuilder::begin() {
+  mNames.resize(mCommittedNamesSize);
+}
+
+void ScanIndexBuilder::addName(const char *name) {
+  mNames.append(name, strlen(name) + 1);
+}
+
+void ScanIndexBuilder::commit(const ScanIndexKey &key, DirectoryOutcome outcome) {
+  if (outcome == DirectoryOutcome::Repository) {
+    mNames.resize(mCommittedNamesSize);
+  }
+
+  ScanIndexRecord record;
+  record.device = key.device;
+  record.inode = key.inode;
+  record.mtimeSeconds = key.mtimeSeconds;
+  record.mtimeNanoseconds = key.mtimeNanoseconds;
+  record.namesOffset = mCommittedNamesSize;
+  record.namesLength = mNames.size() - mCommittedNamesSize;
+  record.outcome = (std::uint32_t)outcome;
+  record.reserved = 0;
+  mRecords.push_back(record);
+
+  mCommittedNamesSize = mNames.size();
+}
+
+void ScanIndexBuilder::copy(const ScanIndexRecord &record, const char *names) {
+  mNames.resize(mCommittedNamesSize);
+  mNames.append(names, record.namesLength);
+
+  ScanIndexRecord copiedRecord = record;
+  copiedRecord.namesOffset = mCommittedNamesSize;
+  mRecords.push_back(copiedRecord);
+
+  mCommittedNamesSize = mNames.size();
+}
+
+bool ScanIndexBuilder::write(const std::string &indexPath, const std::vector<ScanIndexBuilder> &builders, std::uint32_t flags) {
+  std::vector<ScanIndexRecord> records;
+  std::uint64_t namesSize = 0;
+  for (const auto &builder : builders) {
+    for (ScanIndexRecord record : builder.mRecords) {
+      record.namesOffset += namesSize;
+      records.push_back(record);
+    }
+    namesSize += builder.mCommittedNamesSize;
+  }
+
+  // A directory reached twice in one scan, through a bind mount for instance, is recorded by every visit.
+  // Only its newest record is kept, lookups and validation expect each directory once.
+  std::sort(records.begin(), records.end(), [](const ScanIndexRecord &lhs, const ScanIndexRecord &rhs) {
+    if (compareRecords(lhs, rhs) || compareRecords(rhs, lhs)) {
+      return compareRecords(lhs, rhs);
+    }
+    return lhs.mtimeSeconds != rhs.mtimeSeconds
+      ? lhs.mtimeSeconds > rhs.mtimeSeconds
+      : lhs.mtimeNanoseconds > rhs.mtimeNanoseconds;
+  });
+  records.erase(std::unique(records.begin(), records.end(), [](const ScanIndexRecord &lhs, const ScanIndexRecord &rhs) {
+    return !compareRecords(lhs, rhs) && !compareRecords(rhs, lhs);
+  }), records.end());
+
+  ScanIndexHeader header;
+  memcpy(header.magic, kScanIndexMagic, sizeof(kScanIndexMagic));
+  header.version = kScanIndexVersion;
+  header.recordSize = sizeof(ScanIndexRecord);
+  header.flags = flags;
+  header.recordCount = records.size();
+  header.namesSize = namesSize;
+
+  // Write next to the index and rename over it, so a concurrent or interrupted scan never sees half of it.
+  const std::string temporaryPath = indexPath + ".tmp";
+  int descriptor = open(temporaryPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (descriptor < 0) {
+    return false;
+  }
+
+  bool success = writeAll(descriptor, &header, sizeof(header))
+    && writeAll(descriptor, records.data(), records.size() * sizeof(ScanIndexRecord));
+  for (const auto &builder : builders) {
+    success = success && writeAll(descriptor, builder.mNames.data(), builder.mCommittedNamesSize);
+  }
+
+  if (close(descriptor) < 0 || !success || rename(temporaryPath.c_str(), indexPath.c_str()) < 0) {
+    unlink(temporaryPath.c_str());
+    return false;
+  }
+
+  return true;
+}
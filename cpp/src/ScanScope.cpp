@@ -0,0 +1,264 @@
+#include "../includes/ScanScope.h"
+#include "../includes/RepositoryInfo.h"
+
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+  bool isBelow(const std::string &path, const std::string &root) {
+    return path.size() > root.size() + 1
+      && path.compare(0, root.size(), root) == 0
+      && path[root.size()] == '/';
+  }
+
+  // path with from, the root it was reported below, swapped for to. The search does not follow symlinks
+  // below its root, so the rest of the path is the same whichever way the root is spelled. Paths outside
+  // from are left alone.
+  std::string rebase(const std::string &path, const std::string &from, const std::string &to) {
+    if (from == to || path.compare(0, from.size(), from) != 0) {
+      return path;
+    }
+
+    if (path.size() == from.size()) {
+      return to;
+    }
+    return path[from.size()] == '/' ? to + path.substr(from.size()) : path;
+  }
+
+  // Calls onRepository with the directory of every record and returns false as soon as it does. The path
+  // of a classified record is its second field, the work tree. Otherwise the .git directory in it is
+  // reported.
+  template<typename Callback>
+  bool forEachRepository(const std::string &records, bool classify, Callback onRepository) {
+    const size_t numFields = classify ? kRepositoryInfoFields : 1;
+    const char *record = records.data();
+    const char *end = records.data() + records.size();
+    while (record < end) {
+      const char *path = classify ? record + strlen(record) + 1 : record;
+      const char *next = record;
+      for (size_t i = 0; i < numFields; ++i) {
+        next += strlen(next) + 1;
+      }
+
+      std::string repositoryPath(path);
+      if (!classify && repositoryPath.size() > 5 && repositoryPath.compare(repositoryPath.size() - 5, 5, "/.git") == 0) {
+        repositoryPath.resize(repositoryPath.size() - 5);
+      }
+      if (!onRepository(repositoryPath, record, next)) {
+        return false;
+      }
+      record = next;
+    }
+    return true;
+  }
+
+  bool reportsRepositoryAtOrAbove(
+    const std::string &records,
+    bool classify,
+    const std::string &sourceRoot,
+    const std::string &sourceCanonicalRoot,
+    const std::string &canonicalPath
+  ) {
+    return !forEachRepository(records, classify, [&](const std::string &repositoryPath, const char *, const char *) {
+      const std::string canonicalRepositoryPath = rebase(repositoryPath, sourceRoot, sourceCanonicalRoot);
+      return canonicalRepositoryPath != canonicalPath && !isBelow(canonicalPath, canonicalRepositoryPath);
+    });
+  }
+}
+
+ScanScope makeScanScope(const std::string &root, const SearchOptions &searchOptions) {
+  ScanScope scope;
+  scope.root = root;
+  #if defined(_WIN32)
+  scope.canonicalRoot = root;
+  scope.canonical = false;
+  #else
+  char *canonicalRoot = realpath(root.c_str(), nullptr);
+  scope.canonicalRoot = canonicalRoot ? canonicalRoot : root;
+  scope.canonical = canonicalRoot != nullptr;
+  free(canonicalRoot);
+  #endif
+
+  scope.classify = searchOptions.classify;
+  scope.reportKey = std::string(searchOptions.classify ? "classify" : "") + (searchOptions.readHead ? ",readHead" : "");
+  scope.mountOptions = searchOptions.oneFileSystem
+    || searchOptions.skipPseudoFileSystems
+    || !searchOptions.skipFileSystemTypes.empty()
+    || !searchOptions.mountLimits.empty();
+  scope.unrestricted = !searchOptions.maxSubfolderDeep && searchOptions.patterns.empty() && !scope.mountOptions;
+
+  // Fields are NUL terminated, so no pattern or file system type can be mistaken for another field.
+  std::string &key = scope.optionsKey;
+  key = scope.reportKey + '\0' + std::to_string(searchOptions.maxSubfolderDeep) + '\0';
+  for (const std::string &pattern : searchOptions.patterns) {
+    key += pattern + '\0';
+  }
+  key += std::string(searchOptions.oneFileSystem ? "1" : "0") + (searchOptions.skipPseudoFileSystems ? "1" : "0") + '\0';
+  for (const std::string &type : searchOptions.skipFileSystemTypes) {
+    key += type + '\0';
+  }
+  for (const auto &mountLimit : searchOptions.mountLimits) {
+    key += mountLimit.first + '\0' + std::to_string(mountLimit.second.concurrency) + ','
+      + std::to_string(mountLimit.second.timeoutMS) + '\0';
+  }
+  return scope;
+}
+
+bool scopeCovers(const ScanScope &outer, const std::string &outerRepositories, const ScanScope &inner, bool &exact) {
+  exact = outer.canonicalRoot == inner.canonicalRoot && outer.optionsKey == inner.optionsKey;
+  if (exact) {
+    return true;
+  }
+
+  return outer.canonical
+    && inner.canonical
+    && outer.unrestricted
+    && !inner.mountOptions
+    && outer.reportKey == inner.reportKey
+    && isBelow(inner.canonicalRoot, outer.canonicalRoot)
+    && !reportsRepositoryAtOrAbove(outerRepositories, outer, inner.canonicalRoot);
+}
+
+bool reportsRepositoryAtOrAbove(const std::string &records, const ScanScope &source, const std::string &canonicalPath) {
+  return reportsRepositoryAtOrAbove(records, source.classify, source.root, source.canonicalRoot, canonicalPath);
+}
+
+RepositoryFilter::RepositoryFilter():
+  mKeepAll(true),
+  mExact(true),
+  mMaxSubfolderDeep(0),
+  mClassify(false)
+{}
+
+RepositoryFilter::RepositoryFilter(
+  const ScanScope &source,
+  const ScanScope &scope,
+  bool exact,
+  std::uint32_t maxSubfolderDeep,
+  const PathMatcher &pathMatcher
+):
+  mKeepAll(exact && source.root == scope.root),
+  mExact(exact),
+  mSourceRoot(source.root),
+  mSourceCanonicalRoot(source.canonicalRoot),
+  mCanonicalRoot(scope.canonicalRoot),
+  mRoot(scope.root),
+  mMaxSubfolderDeep(maxSubfolderDeep),
+  mPathMatcher(pathMatcher),
+  mClassify(scope.classify)
+{}
+
+bool RepositoryFilter::keepsAll() const {
+  return mKeepAll;
+}
+
+void RepositoryFilter::filter(const std::string &batch, std::string &filtered) const {
+  if (mKeepAll) {
+    filtered += batch;
+    return;
+  }
+
+  forEachRepository(batch, mClassify, [this, &filtered](const std::string &repositoryPath, const char *record, const char *next) {
+    if (mExact || contains(rebase(repositoryPath, mSourceRoot, mSourceCanonicalRoot))) {
+      appendRebased(record, next, filtered);
+    }
+    return true;
+  });
+}
+
+bool RepositoryFilter::hidesRoot(const std::string &batch) const {
+  return !mExact && reportsRepositoryAtOrAbove(batch, mClassify, mSourceRoot, mSourceCanonicalRoot, mCanonicalRoot);
+}
+
+// The repository was found in a directory the nested search would have read: one whose depth below its
+// root is within the limit, and none of whose path segments is excluded.
+bool RepositoryFilter::contains(const std::string &canonicalPath) const {
+  if (canonicalPath == mCanonicalRoot) {
+    return true;
+  }
+
+  if (!isBelow(canonicalPath, mCanonicalRoot)) {
+    return false;
+  }
+
+  PathMatcher::State matchState = mPathMatcher.initialState();
+  std::uint32_t depth = 0;
+  size_t start = mCanonicalRoot.size() + 1;
+  while (start <= canonicalPath.size()) {
+    size_t slash = canonicalPath.find('/', start);
+    if (slash == std::string::npos) {
+      slash = canonicalPath.size();
+    }
+
+    if (mMaxSubfolderDeep && ++depth > mMaxSubfolderDeep) {
+      return false;
+    }
+
+    const std::string name = canonicalPath.substr(start, slash - start);
+    PathMatcher::State childState;
+    if (mPathMatcher.isExcluded(matchState, name.c_str(), childState)) {
+      return false;
+    }
+    matchState = childState;
+    start = slash + 1;
+  }
+
+  return true;
+}
+
+// Only the fields holding paths are spelled again: the .git directory, or the work tree and git directory
+// of a classified record.
+void RepositoryFilter::appendRebased(const char *record, const char *end, std::string &filtered) const {
+  if (mKeepAll) {
+    filtered.append(record, end - record);
+    return;
+  }
+
+  for (size_t i = 0; record < end; ++i) {
+    const std::string field(record);
+    record += field.size() + 1;
+    if (mClassify && i != 1 && i != 2) {
+      filtered += field;
+    } else {
+      filtered += rebase(rebase(field, mSourceRoot, mSourceCanonicalRoot), mCanonicalRoot, mRoot);
+    }
+    filtered += '\0';
+  }
+}
+
+void ScanResultCache::add(const ScanScope &scope, std::shared_ptr<const std::string> repositories, std::uint32_t timeToLiveMS) {
+  evictExpired();
+
+  for (auto entry = mEntries.begin(); entry != mEntries.end(); ++entry) {
+    if (entry->scope.canonicalRoot == scope.canonicalRoot && entry->scope.optionsKey == scope.optionsKey) {
+      mEntries.erase(entry);
+      break;
+    }
+  }
+
+  if (mEntries.size() == kMaxEntries) {
+    mEntries.pop_front();
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  mEntries.push_back({ scope, std::move(repositories), now, now + std::chrono::milliseconds(timeToLiveMS) });
+}
+
+const ScanResultCache::Entry *ScanResultCache::find(const ScanScope &scope, std::uint32_t maxAgeMS, bool &exact) {
+  evictExpired();
+
+  const auto oldest = std::chrono::steady_clock::now() - std::chrono::milliseconds(maxAgeMS);
+  for (auto entry = mEntries.rbegin(); entry != mEntries.rend(); ++entry) {
+    if (entry->completed >= oldest && scopeCovers(entry->scope, *entry->repositories, scope, exact)) {
+      return &*entry;
+    }
+  }
+  return nullptr;
+}
+
+void ScanResultCache::evictExpired() {
+  const auto now = std::chrono::steady_clock::now();
+  for (auto entry = mEntries.begin(); entry != mEntries.end(); ) {
+    entry = entry->expires <= now ? mEntries.erase(entry) : entry + 1;
+  }
+}
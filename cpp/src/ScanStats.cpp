@@ -0,0 +1,148 @@
+#include "../includes/ScanStats.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+TraversalStats::TraversalStats():
+  directoriesOpened(0),
+  directoriesFromIndex(0),
+  directoryReads(0),
+  entriesRead(0),
+  statFallbacks(0),
+  repositoriesFound(0),
+  duplicateDirectories(0),
+  mountsSkipped(0),
+  mountsTimedOut(0),
+  maxPendingDirectories(0),
+  maxFrontierMemoryUsage(0),
+  cpuTimeNS(0),
+  throttledNS(0),
+  latencySamples(0),
+  directoriesUntilSample(0)
+{
+  memset(latencyHistogram, 0, sizeof(latencyHistogram));
+}
+
+void TraversalStats::recordFailedOpen(int error) {
+  ++failedOpens[error];
+}
+
+void TraversalStats::recordFailedRead(int error) {
+  ++failedReads[error];
+}
+
+bool TraversalStats::shouldSampleLatency(std::uint32_t sampleInterval) {
+  if (directoriesUntilSample > 0) {
+    --directoriesUntilSample;
+    return false;
+  }
+
+  directoriesUntilSample = sampleInterval - 1;
+  return true;
+}
+
+void TraversalStats::recordLatency(std::uint64_t latencyNS) {
+  size_t bucket = 0;
+  for (std::uint64_t latencyUS = latencyNS / 1000; latencyUS > 1 && bucket < kNumLatencyBuckets - 1; latencyUS >>= 1) {
+    ++bucket;
+  }
+
+  ++latencyHistogram[bucket];
+  ++latencySamples;
+}
+
+bool TraversalStats::isAmongSlowest(std::uint64_t latencyNS) const {
+  return slowestDirectories.size() < kMaxSlowDirectories || latencyNS > slowestDirectories.back().latencyNS;
+}
+
+void TraversalStats::addSlowDirectory(std::uint64_t latencyNS, std::string path) {
+  auto position = std::find_if(slowestDirectories.begin(), slowestDirectories.end(), [latencyNS](const SlowDirectory &directory) {
+    return directory.latencyNS < latencyNS;
+  });
+  slowestDirectories.insert(position, { latencyNS, std::move(path) });
+
+  if (slowestDirectories.size() > kMaxSlowDirectories) {
+    slowestDirectories.pop_back();
+  }
+}
+
+void TraversalStats::merge(const TraversalStats &other) {
+  directoriesOpened += other.directoriesOpened;
+  directoriesFromIndex += other.directoriesFromIndex;
+  directoryReads += other.directoryReads;
+  entriesRead += other.entriesRead;
+  statFallbacks += other.statFallbacks;
+  repositoriesFound += other.repositoriesFound;
+  duplicateDirectories += other.duplicateDirectories;
+  mountsSkipped += other.mountsSkipped;
+  mountsTimedOut += other.mountsTimedOut;
+  maxPendingDirectories = std::max(maxPendingDirectories, other.maxPendingDirectories);
+  maxFrontierMemoryUsage = std::max(maxFrontierMemoryUsage, other.maxFrontierMemoryUsage);
+  cpuTimeNS += other.cpuTimeNS;
+  throttledNS += other.throttledNS;
+
+  for (const auto &failedOpen : other.failedOpens) {
+    failedOpens[failedOpen.first] += failedOpen.second;
+  }
+  for (const auto &failedRead : other.failedReads) {
+    failedReads[failedRead.first] += failedRead.second;
+  }
+
+  latencySamples += other.latencySamples;
+  for (size_t i = 0; i < kNumLatencyBuckets; ++i) {
+    latencyHistogram[i] += other.latencyHistogram[i];
+  }
+
+  for (const auto &directory : other.slowestDirectories) {
+    if (isAmongSlowest(directory.latencyNS)) {
+      addSlowDirectory(directory.latencyNS, directory.path);
+    }
+  }
+}
+
+PhaseTimer::PhaseTimer():
+  wallTimeNS(0),
+  cpuTimeNS(0),
+  mWallStartNS(0),
+  mCpuStartNS(0)
+{}
+
+void PhaseTimer::start() {
+  mWallStartNS = ::wallTimeNS();
+  mCpuStartNS = threadCpuTimeNS();
+}
+
+void PhaseTimer::stop() {
+  wallTimeNS += ::wallTimeNS() - mWallStartNS;
+  cpuTimeNS += threadCpuTimeNS() - mCpuStartNS;
+}
+
+std::uint64_t threadCpuTimeNS() {
+  #if defined(_WIN32)
+  FILETIME creationTime, exitTime, kernelTime, userTime;
+  if (!GetThreadTimes(GetCurrentThread(), &creationTime, &exitTime, &kernelTime, &userTime)) {
+    return 0;
+  }
+
+  const std::uint64_t kernel = ((std::uint64_t)kernelTime.dwHighDateTime << 32) | kernelTime.dwLowDateTime;
+  const std::uint64_t user = ((std::uint64_t)userTime.dwHighDateTime << 32) | userTime.dwLowDateTime;
+  return (kernel + user) * 100;
+  #else
+  struct timespec time;
+  if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) < 0) {
+    return 0;
+  }
+
+  return (std::uint64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+  #endif
+}
+
+std::uint64_t wallTimeNS() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
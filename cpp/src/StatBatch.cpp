@@ -0,0 +1,373 @@
+#include "../includes/StatBatch.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+// IORING_OP_STATX is an enum value, the feature flag added with it by the same kernel release tells
+// whether the headers know about it.
+#if defined(IORING_FEAT_CUR_PERSONALITY) && defined(STATX_TYPE) && defined(__NR_io_uring_setup)
+#define HAVE_IO_URING_STATX 1
+#endif
+#endif
+
+namespace {
+  const size_t kNumPoolThreads = 16;
+
+  bool statIsDirectory(int directoryDescriptor, const char *name) {
+    struct stat statBuffer;
+    return fstatat(directoryDescriptor, name, &statBuffer, AT_SYMLINK_NOFOLLOW) == 0 && S_ISDIR(statBuffer.st_mode);
+  }
+
+  // Shared by every traversal thread. The thread resolving a batch works on it too, so a batch completes
+  // even while the pool is busy with the batches of other threads.
+  class StatThreadPool {
+  public:
+    static StatThreadPool &instance() {
+      // Never destroyed, its threads may still be waiting for work when the process exits.
+      static StatThreadPool *pool = new StatThreadPool;
+      return *pool;
+    }
+
+    void resolve(int directoryDescriptor, const std::vector<const char *> &names, std::vector<unsigned char> &isDirectory) {
+      std::shared_ptr<Job> job(new Job(directoryDescriptor, names, isDirectory));
+      {
+        std::lock_guard<std::mutex> lock(mMutex);
+        startThreads();
+        mJobs.push_back(job);
+      }
+      mWorkCondition.notify_all();
+
+      work(*job);
+
+      std::unique_lock<std::mutex> lock(mMutex);
+      mDoneCondition.wait(lock, [&job]() { return job->numDone == job->size; });
+    }
+
+  private:
+    struct Job {
+      Job(int _directoryDescriptor, const std::vector<const char *> &_names, std::vector<unsigned char> &_isDirectory):
+        directoryDescriptor(_directoryDescriptor),
+        names(_names),
+        isDirectory(_isDirectory),
+        size(_names.size()),
+        nextIndex(0),
+        numDone(0)
+      {}
+
+      const int directoryDescriptor;
+      const std::vector<const char *> &names;
+      std::vector<unsigned char> &isDirectory;
+      // The vectors are gone once the batch is resolved, the pool threads that find it afterwards only
+      // look at its size.
+      const size_t size;
+      std::atomic<size_t> nextIndex;
+      std::atomic<size_t> numDone;
+    };
+
+    void startThreads() {
+      if (!mThreads.empty()) {
+        return;
+      }
+
+      for (size_t i = 0; i < kNumPoolThreads; ++i) {
+        mThreads.emplace_back([this]() { run(); });
+        mThreads.back().detach();
+      }
+    }
+
+    void run() {
+      std::unique_lock<std::mutex> lock(mMutex);
+      while (true) {
+        mWorkCondition.wait(lock, [this]() { return !mJobs.empty(); });
+        std::shared_ptr<Job> job = mJobs.front();
+
+        lock.unlock();
+        work(*job);
+        lock.lock();
+
+        // Every entry of the job is claimed now, the threads still working on it finish it.
+        if (!mJobs.empty() && mJobs.front() == job) {
+          mJobs.pop_front();
+        }
+      }
+    }
+
+    void work(Job &job) {
+      size_t index;
+      while ((index = job.nextIndex++) < job.size) {
+        job.isDirectory[index] = statIsDirectory(job.directoryDescriptor, job.names[index]);
+        if (++job.numDone == job.size) {
+          std::lock_guard<std::mutex> lock(mMutex);
+          mDoneCondition.notify_all();
+        }
+      }
+    }
+
+    std::mutex mMutex;
+    std::condition_variable mWorkCondition;
+    std::condition_variable mDoneCondition;
+    std::deque<std::shared_ptr<Job>> mJobs;
+    std::vector<std::thread> mThreads;
+  };
+
+  #if defined(HAVE_IO_URING_STATX)
+  // A minimal io_uring, one per traversal thread, only used to submit statx requests and wait for them.
+  class StatRing {
+  public:
+    static const unsigned kNumEntries = 64;
+
+    // Returns null when io_uring or its statx operation is not available, for instance on kernels older
+    // than 5.6 or when a seccomp profile blocks it. The pool is used from then on.
+    static StatRing *forThisThread() {
+      if (sUnsupported) {
+        return nullptr;
+      }
+
+      thread_local std::unique_ptr<StatRing> ring;
+      if (!ring) {
+        ring.reset(new StatRing);
+        if (!ring->initialize()) {
+          sUnsupported = true;
+          ring.reset();
+        }
+      }
+      return ring.get();
+    }
+
+    ~StatRing() {
+      if (mSubmissionEntries != MAP_FAILED) {
+        munmap(mSubmissionEntries, mSubmissionEntriesSize);
+      }
+      if (mCompletionRing != MAP_FAILED && mCompletionRing != mSubmissionRing) {
+        munmap(mCompletionRing, mCompletionRingSize);
+      }
+      if (mSubmissionRing != MAP_FAILED) {
+        munmap(mSubmissionRing, mSubmissionRingSize);
+      }
+      if (mDescriptor >= 0) {
+        close(mDescriptor);
+      }
+    }
+
+    bool resolve(int directoryDescriptor, const std::vector<const char *> &names, std::vector<unsigned char> &isDirectory) {
+      mStatBuffers.resize(std::min<size_t>(names.size(), mNumSubmissionEntries));
+      for (size_t first = 0; first < names.size(); first += mNumSubmissionEntries) {
+        const unsigned count = (unsigned)std::min<size_t>(names.size() - first, mNumSubmissionEntries);
+        if (!resolveChunk(directoryDescriptor, names, isDirectory, first, count)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  private:
+    StatRing():
+      mDescriptor(-1),
+      mSubmissionRing(MAP_FAILED),
+      mCompletionRing(MAP_FAILED),
+      mSubmissionEntries(MAP_FAILED)
+    {}
+
+    bool initialize() {
+      struct io_uring_params params;
+      memset(&params, 0, sizeof(params));
+      mDescriptor = (int)syscall(__NR_io_uring_setup, kNumEntries, &params);
+      if (mDescriptor < 0) {
+        return false;
+      }
+
+      mNumSubmissionEntries = params.sq_entries;
+      mSubmissionRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      mCompletionRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+      const bool singleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+      if (singleMap) {
+        mSubmissionRingSize = mCompletionRingSize = std::max(mSubmissionRingSize, mCompletionRingSize);
+      }
+
+      mSubmissionRing = mmap(nullptr, mSubmissionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mDescriptor, IORING_OFF_SQ_RING);
+      if (mSubmissionRing == MAP_FAILED) {
+        return false;
+      }
+
+      mCompletionRing = singleMap
+        ? mSubmissionRing
+        : mmap(nullptr, mCompletionRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mDescriptor, IORING_OFF_CQ_RING);
+      if (mCompletionRing == MAP_FAILED) {
+        return false;
+      }
+
+      mSubmissionEntriesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+      mSubmissionEntries = mmap(nullptr, mSubmissionEntriesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, mDescriptor, IORING_OFF_SQES);
+      if (mSubmissionEntries == MAP_FAILED) {
+        return false;
+      }
+
+      char *submissionRing = static_cast<char *>(mSubmissionRing);
+      mSubmissionTail = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.tail);
+      mSubmissionMask = *reinterpret_cast<unsigned *>(submissionRing + params.sq_off.ring_mask);
+      mSubmissionArray = reinterpret_cast<unsigned *>(submissionRing + params.sq_off.array);
+
+      char *completionRing = static_cast<char *>(mCompletionRing);
+      mCompletionHead = reinterpret_cast<unsigned *>(completionRing + params.cq_off.head);
+      mCompletionTail = reinterpret_cast<unsigned *>(completionRing + params.cq_off.tail);
+      mCompletionMask = *reinterpret_cast<unsigned *>(completionRing + params.cq_off.ring_mask);
+      mCompletionEntries = reinterpret_cast<struct io_uring_cqe *>(completionRing + params.cq_off.cqes);
+      return true;
+    }
+
+    bool resolveChunk(
+      int directoryDescriptor,
+      const std::vector<const char *> &names,
+      std::vector<unsigned char> &isDirectory,
+      size_t first,
+      unsigned count
+    ) {
+      struct io_uring_sqe *submissionEntries = static_cast<struct io_uring_sqe *>(mSubmissionEntries);
+      unsigned tail = *mSubmissionTail;
+      for (unsigned i = 0; i < count; ++i) {
+        const unsigned index = tail & mSubmissionMask;
+        struct io_uring_sqe &entry = submissionEntries[index];
+        memset(&entry, 0, sizeof(entry));
+        entry.opcode = IORING_OP_STATX;
+        entry.fd = directoryDescriptor;
+        entry.addr = (unsigned long long)names[first + i];
+        entry.len = STATX_TYPE;
+        entry.off = (unsigned long long)&mStatBuffers[i];
+        entry.statx_flags = AT_SYMLINK_NOFOLLOW;
+        entry.user_data = i;
+        mSubmissionArray[index] = index;
+        ++tail;
+      }
+      __atomic_store_n(mSubmissionTail, tail, __ATOMIC_RELEASE);
+
+      unsigned numSubmitted = 0;
+      unsigned numCompleted = 0;
+      bool supported = true;
+      while (numCompleted < count) {
+        const unsigned toSubmit = count - numSubmitted;
+        const int result = (int)syscall(__NR_io_uring_enter, mDescriptor, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (result < 0) {
+          if (errno == EINTR || errno == EAGAIN || errno == EBUSY) {
+            continue;
+          }
+          // Requests that were submitted still complete into buffers owned by this ring, which is why the
+          // ring is kept rather than destroyed when it fails.
+          sUnsupported = true;
+          return false;
+        }
+        numSubmitted += (unsigned)result;
+
+        unsigned head = *mCompletionHead;
+        const unsigned completionTail = __atomic_load_n(mCompletionTail, __ATOMIC_ACQUIRE);
+        for (; head != completionTail; ++head) {
+          const struct io_uring_cqe &completion = mCompletionEntries[head & mCompletionMask];
+          const size_t i = (size_t)completion.user_data;
+          if (completion.res == -EINVAL || completion.res == -EOPNOTSUPP) {
+            supported = false;
+          }
+          isDirectory[first + i] = completion.res == 0 && S_ISDIR(mStatBuffers[i].stx_mode);
+          ++numCompleted;
+        }
+        __atomic_store_n(mCompletionHead, head, __ATOMIC_RELEASE);
+      }
+
+      if (!supported) {
+        sUnsupported = true;
+      }
+      return supported;
+    }
+
+    static std::atomic<bool> sUnsupported;
+
+    int mDescriptor;
+    void *mSubmissionRing;
+    void *mCompletionRing;
+    void *mSubmissionEntries;
+    size_t mSubmissionRingSize;
+    size_t mCompletionRingSize;
+    size_t mSubmissionEntriesSize;
+    unsigned mNumSubmissionEntries;
+    unsigned *mSubmissionTail;
+    unsigned mSubmissionMask;
+    unsigned *mSubmissionArray;
+    unsigned *mCompletionHead;
+    unsigned *mCompletionTail;
+    unsigned mCompletionMask;
+    struct io_uring_cqe *mCompletionEntries;
+    std::vector<struct statx> mStatBuffers;
+  };
+
+  std::atomic<bool> StatRing::sUnsupported(false);
+  #endif
+}
+
+void StatBatch::clear() {
+  mNames.clear();
+  mNameOffsets.clear();
+}
+
+void StatBatch::add(const char *name) {
+  mNameOffsets.push_back(mNames.size());
+  mNames.append(name);
+  mNames.push_back('\0');
+}
+
+size_t StatBatch::size() const {
+  return mNameOffsets.size();
+}
+
+const char *StatBatch::name(size_t index) const {
+  return mNames.data() + mNameOffsets[index];
+}
+
+bool StatBatch::isDirectory(size_t index) const {
+  return mIsDirectory[index];
+}
+
+void StatBatch::resolve(int directoryDescriptor) {
+  mIsDirectory.assign(size(), 0);
+  if (size() == 0) {
+    return;
+  }
+
+  if (size() == 1) {
+    mIsDirectory[0] = statIsDirectory(directoryDescriptor, name(0));
+    return;
+  }
+
+  // The names only stop moving once the batch is complete.
+  mNamePointers.clear();
+  for (size_t i = 0; i < size(); ++i) {
+    mNamePointers.push_back(name(i));
+  }
+
+  #if defined(HAVE_IO_URING_STATX)
+  StatRing *ring = StatRing::forThisThread();
+  if (ring && ring->resolve(directoryDescriptor, mNamePointers, mIsDirectory)) {
+    return;
+  }
+  #endif
+
+  StatThreadPool::instance().resolve(directoryDescriptor, mNamePointers, mIsDirectory);
+}
+
+void StatBatch::resolveInThisThread(int directoryDescriptor) {
+  mIsDirectory.assign(size(), 0);
+  for (size_t i = 0; i < size(); ++i) {
+    mIsDirectory[i] = statIsDirectory(directoryDescriptor, name(i));
+  }
+}
@@ -0,0 +1,27 @@
+#include "../includes/VisitedSet.h"
+
+namespace {
+  std::uint64_t mix(std::uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+  }
+
+  std::uint64_t hashDirectory(std::uint64_t device, std::uint64_t inode) {
+    return mix(inode ^ mix(device));
+  }
+}
+
+size_t VisitedSet::KeyHash::operator()(const Key &key) const {
+  return (size_t)hashDirectory(key.device, key.inode);
+}
+
+bool VisitedSet::insert(std::uint64_t device, std::uint64_t inode) {
+  // The low bits pick the bucket inside a shard, so the shard comes from the high bits.
+  Shard &shard = mShards[(hashDirectory(device, inode) >> 58) % kNumShards];
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  return shard.keys.insert({ device, inode }).second;
+}
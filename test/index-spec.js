@@ -1,8 +1,11 @@
 const assert = require('assert');
+const { execFileSync } = require('child_process');
 const fs = require('fs');
 const mlog = require('mocha-logger');
 const path = require('path');
+const rimraf = require('rimraf');
 
+const backdateTree = require('./util/backdateTree');
 const createTree = require('./util/createTree');
 const findGitRepos = require('..');
 
@@ -14,6 +17,12 @@ describe('findGitRepos', function() {
         .catch(() => done());
     });
 
+    it('will fail if provided an empty array of paths', function(done) {
+      findGitRepos([], () => {})
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
     it('will fail if not provided a progress callback', function(done) {
       findGitRepos('test')
         .then(() => done('Should not have succeeded'))
@@ -49,6 +58,120 @@ describe('findGitRepos', function() {
         .then(() => done('Should not have succeeded'))
         .catch(() => done());
     });
+
+    it('will fail if exclude is not an array of strings', function(done) {
+      findGitRepos('test', () => {}, { exclude: ['node_modules', 1] })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if concurrency is not a number', function(done) {
+      findGitRepos('test', () => {}, { concurrency: 'WrongValue' })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if concurrency number is less than 1', function(done) {
+      findGitRepos('test', () => {}, { concurrency: 0 })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if frontierMemoryLimitMB number is not greater than 0', function(done) {
+      findGitRepos('test', () => {}, { frontierMemoryLimitMB: 0 })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if collectRepositories is not a boolean', function(done) {
+      findGitRepos('test', () => {}, { collectRepositories: 'WrongValue' })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if stats is not a boolean', function(done) {
+      findGitRepos('test', () => {}, { stats: 'WrongValue' })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if classify is not a boolean', function(done) {
+      findGitRepos('test', () => {}, { classify: 'WrongValue' })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if latencySampleInterval number is larger than 1000000', function(done) {
+      findGitRepos('test', () => {}, { latencySampleInterval: 1000001 })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if cacheTTLMS number is larger than 60000', function(done) {
+      findGitRepos('test', () => {}, { cacheTTLMS: 60001 })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if maxDirectories number is less than 1', function(done) {
+      findGitRepos('test', () => {}, { maxDirectories: 0 })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if background directoriesPerSecond is less than 1', function(done) {
+      findGitRepos('test', () => {}, { background: { directoriesPerSecond: 0 } })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if a mountLimits concurrency is less than 1', function(done) {
+      findGitRepos('test', () => {}, { mountLimits: { nfs: { concurrency: 0 } } })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail if fileSystem is not a loaded snapshot', function(done) {
+      findGitRepos('test', () => {}, { fileSystem: { path: 'test', entries: 1 } })
+        .then(() => done('Should not have succeeded'))
+        .catch(() => done());
+    });
+
+    it('will fail to stream if highWaterMark number is less than 1', function() {
+      assert.throws(() => findGitRepos.stream('test', { highWaterMark: 0 }), TypeError);
+    });
+
+    it('will fail to stream if highWaterMark is not an integer up to 1000000', function() {
+      [NaN, 1.5, 1000001, 2 ** 32].forEach(highWaterMark => {
+        assert.throws(() => findGitRepos.stream('test', { highWaterMark }), TypeError, `Accepted ${highWaterMark}`);
+      });
+    });
+
+    it('will fail to stream if lowWaterMark is not an integer up to highWaterMark', function() {
+      [NaN, 0.5, 9].forEach(lowWaterMark => {
+        assert.throws(() => findGitRepos.stream('test', { highWaterMark: 8, lowWaterMark }), TypeError, `Accepted ${lowWaterMark}`);
+      });
+    });
+
+    if (process.platform === 'linux') {
+      it('will fail to watch if maxWatches is not an integer up to 1000000', function() {
+        [NaN, 0, 1.5, 1000001, 2 ** 32].forEach(maxWatches => {
+          assert.throws(() => findGitRepos.watch('test', () => {}, { maxWatches }), TypeError, `Accepted ${maxWatches}`);
+        });
+      });
+
+      it('will fail to watch with options it cannot keep current', function() {
+        [{ classify: true }, { readHead: true }, { deadlineMS: 1000 }, { maxDirectories: 10 }].forEach(options => {
+          assert.throws(() => findGitRepos.watch('test', () => {}, options), TypeError, `Accepted ${JSON.stringify(options)}`);
+        });
+      });
+
+      it('will fail to watch if pollIntervalMS is not an integer up to 3600000', function() {
+        [NaN, -1, 0.5, 3600001, 2 ** 31].forEach(pollIntervalMS => {
+          assert.throws(() => findGitRepos.watch('test', () => {}, { pollIntervalMS }), TypeError, `Accepted ${pollIntervalMS}`);
+        });
+      });
+    }
   });
 
   describe('Features', function() {
@@ -121,6 +244,530 @@ describe('findGitRepos', function() {
         .catch(error => done(error));
     });
 
+    it('can find all repositories using several traversal threads', function(done) {
+      const { repositoryPaths } = this;
+      let callbackPromisesChain = Promise.resolve();
+      let triggeredProgressCallbackOnce = false;
+
+      const progressCallback = paths => {
+        triggeredProgressCallbackOnce = true;
+
+        callbackPromisesChain = paths.reduce((chain, repositoryPath) =>
+          chain.then(() => {
+            assert.equal(
+              repositoryPaths[repositoryPath],
+              Boolean(repositoryPaths[repositoryPath]),
+              'Found a repo that should not exist'
+            );
+            assert.equal(repositoryPaths[repositoryPath], false, 'Duplicate repositoryPath received');
+            repositoryPaths[repositoryPath] = true;
+          }), callbackPromisesChain);
+      };
+
+      findGitRepos(basePath, progressCallback, { throttleTimeoutMS: 100, concurrency: 4 })
+        .then(paths => Promise.all([paths, callbackPromisesChain]))
+        .then(([paths]) => {
+          assert.equal(triggeredProgressCallbackOnce, true, 'Never called progress callback');
+          assert.equal(paths.length, Object.keys(repositoryPaths).length, 'Found a different number of repositories');
+          paths.forEach(repositoryPath => {
+            assert.equal(
+              repositoryPaths[repositoryPath],
+              Boolean(repositoryPaths[repositoryPath]),
+              'Found a repo that should not exist'
+            );
+            repositoryPaths[repositoryPath] = true;
+          });
+
+          Object.keys(repositoryPaths).forEach(repositoryPath => {
+            assert.equal(repositoryPaths[repositoryPath], true, 'Did not find a path in the file system');
+          });
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('can search several overlapping paths at once', function(done) {
+      const { repositoryPaths } = this;
+      const nestedPath = fs.readdirSync(basePath, { withFileTypes: true })
+        .filter(entry => entry.isDirectory())
+        .map(entry => path.join(basePath, entry.name))[0];
+
+      findGitRepos([nestedPath, basePath, basePath], () => {}, { stats: true, concurrency: 2 })
+        .then(({ repositories, stats }) => {
+          assert.deepEqual(repositories.sort(), Object.keys(repositoryPaths).sort(), 'Did not find every repository exactly once');
+          assert.ok(stats.duplicateDirectories > 0, 'Did not skip directories reached from several paths');
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('can share a search with overlapping searches', function(done) {
+      const shareBasePath = path.resolve('.', 'fs-share');
+      const { repositoryPaths } = createTree(shareBasePath, 3, 4);
+      const nestedPath = fs.readdirSync(shareBasePath, { withFileTypes: true })
+        .filter(entry => entry.isDirectory())
+        .map(entry => path.join(shareBasePath, entry.name))[0];
+      const expectedPaths = Object.keys(repositoryPaths).sort();
+      const expectedNestedPaths = expectedPaths.filter(repositoryPath => repositoryPath.startsWith(nestedPath + path.sep));
+      const newRepositoryPath = path.resolve(shareBasePath, 'new_repo', '.git');
+
+      const cleanUp = () => rimraf.sync(shareBasePath);
+
+      let nestedProgressPaths = [];
+      Promise.all([
+        findGitRepos(shareBasePath, () => {}, { cacheTTLMS: 60000 }),
+        findGitRepos(nestedPath, paths => {
+          nestedProgressPaths = nestedProgressPaths.concat(paths);
+        }, { coalesce: true }),
+        findGitRepos(shareBasePath, () => {}, { coalesce: true })
+      ])
+        .then(([paths, nestedPaths, samePaths]) => {
+          assert.deepEqual(paths.sort(), expectedPaths, 'Did not find every repository');
+          assert.deepEqual(nestedPaths.sort(), expectedNestedPaths, 'Did not find the nested repositories');
+          assert.deepEqual(samePaths.sort(), expectedPaths, 'Did not find every repository twice');
+          assert.deepEqual(
+            nestedProgressPaths.filter(repositoryPath => !repositoryPath.startsWith(nestedPath + path.sep)),
+            [],
+            'Reported repositories outside of the nested path'
+          );
+
+          fs.mkdirSync(newRepositoryPath, { recursive: true });
+          return Promise.all([
+            findGitRepos(shareBasePath, () => {}, { cacheTTLMS: 60000 }),
+            findGitRepos(shareBasePath, () => {}, { coalesce: false })
+          ]);
+        })
+        .then(([cachedPaths, freshPaths]) => {
+          assert.deepEqual(cachedPaths.sort(), expectedPaths, 'Did not answer from the cache');
+          assert.deepEqual(freshPaths.sort(), expectedPaths.concat(newRepositoryPath).sort(), 'Did not search again');
+        })
+        .then(() => {
+          cleanUp();
+          done();
+        })
+        .catch(error => {
+          cleanUp();
+          done(error);
+        });
+    });
+
+    if (process.platform !== 'win32') {
+      it('shares a search with other spellings of its path', function() {
+        const shareBasePath = path.resolve('.', 'fs-share-spelled');
+        const linkPath = path.resolve('.', 'fs-share-link');
+        const { repositoryPaths } = createTree(shareBasePath, 3, 4);
+        rimraf.sync(linkPath);
+        fs.symlinkSync(shareBasePath, linkPath);
+        const nestedName = fs.readdirSync(shareBasePath, { withFileTypes: true })
+          .filter(entry => entry.isDirectory())[0].name;
+        const expectedPaths = Object.keys(repositoryPaths).sort();
+        // What a search of root reports on its own: its paths start with root as it was passed.
+        const spelledBelow = (root, from) => expectedPaths
+          .filter(repositoryPath => repositoryPath.startsWith(from + path.sep))
+          .map(repositoryPath => `${root}/${repositoryPath.slice(from.length + 1)}`);
+        const roots = [`${shareBasePath}/.`, `${shareBasePath}/`, linkPath, path.join(linkPath, nestedName)];
+
+        const cleanUp = () => {
+          rimraf.sync(linkPath);
+          rimraf.sync(shareBasePath);
+        };
+
+        return findGitRepos(shareBasePath, () => {}, { cacheTTLMS: 60000 })
+          .then(paths => {
+            assert.deepEqual(paths.sort(), expectedPaths, 'Did not find every repository');
+            fs.mkdirSync(path.resolve(shareBasePath, 'new_repo', '.git'), { recursive: true });
+            return Promise.all(roots.map(root => findGitRepos(root, () => {}, { cacheTTLMS: 60000 })));
+          })
+          .then(([dottedPaths, slashedPaths, linkedPaths, nestedPaths]) => {
+            assert.deepEqual(dottedPaths.sort(), spelledBelow(roots[0], shareBasePath), 'Did not share with a path holding "."');
+            assert.deepEqual(slashedPaths.sort(), spelledBelow(roots[1], shareBasePath), 'Did not share with a trailing slash');
+            assert.deepEqual(linkedPaths.sort(), spelledBelow(roots[2], shareBasePath), 'Did not share with a symlink');
+            assert.deepEqual(
+              nestedPaths.sort(),
+              spelledBelow(roots[3], path.join(shareBasePath, nestedName)),
+              'Did not share with a nested path through a symlink'
+            );
+          })
+          .finally(cleanUp);
+      });
+    }
+
+    it('does not share a search with a path inside one of its repositories', function(done) {
+      const shareBasePath = path.resolve('.', 'fs-share-nested');
+      createTree(shareBasePath, 2, 3);
+      // Holds a repository of its own, which the search of the tree does not go into.
+      const vendoredPath = path.join(shareBasePath, 'guaranteed_repo', 'submodule');
+      const vendoredRepositoryPath = path.join(vendoredPath, '.git');
+
+      const cleanUp = () => rimraf.sync(shareBasePath);
+
+      Promise.all([
+        findGitRepos(shareBasePath, () => {}, { cacheTTLMS: 60000 }),
+        findGitRepos(vendoredPath, () => {}, { coalesce: true })
+      ])
+        .then(([paths, vendoredPaths]) => {
+          assert.ok(!paths.includes(vendoredRepositoryPath), 'Searched inside a repository');
+          assert.deepEqual(vendoredPaths, [vendoredRepositoryPath], 'Did not search the path inside a repository while running');
+          return findGitRepos(vendoredPath, () => {}, { cacheTTLMS: 60000 });
+        })
+        .then(vendoredPaths => {
+          assert.deepEqual(vendoredPaths, [vendoredRepositoryPath], 'Did not search the path inside a repository once cached');
+        })
+        .then(() => {
+          cleanUp();
+          done();
+        })
+        .catch(error => {
+          cleanUp();
+          done(error);
+        });
+    });
+
+    it('can classify worktrees and bare repositories', function(done) {
+      const classifyBasePath = path.resolve('.', 'fs-classify');
+      const mainPath = path.join(classifyBasePath, 'main');
+      const worktreePath = path.join(classifyBasePath, 'worktree');
+      const barePath = path.join(classifyBasePath, 'bare.git');
+      const worktreeGitDir = path.join(mainPath, '.git', 'worktrees', 'worktree');
+
+      rimraf.sync(classifyBasePath);
+      fs.mkdirSync(worktreeGitDir, { recursive: true });
+      fs.writeFileSync(path.join(mainPath, '.git', 'HEAD'), 'ref: refs/heads/main\n');
+      fs.writeFileSync(path.join(worktreeGitDir, 'HEAD'), 'ref: refs/heads/feature\n');
+      fs.mkdirSync(worktreePath);
+      fs.writeFileSync(path.join(worktreePath, '.git'), `gitdir: ${worktreeGitDir}\n`);
+      fs.mkdirSync(path.join(barePath, 'objects'), { recursive: true });
+      fs.mkdirSync(path.join(barePath, 'refs'));
+      fs.writeFileSync(path.join(barePath, 'HEAD'), 'ref: refs/heads/release\n');
+
+      findGitRepos(classifyBasePath, () => {}, { classify: true, readHead: true })
+        .then(repositories => {
+          assert.deepEqual(repositories.sort((a, b) => a.path.localeCompare(b.path)), [
+            { path: barePath, kind: 'bare', gitDir: barePath, branch: 'release' },
+            { path: mainPath, kind: 'repository', gitDir: path.join(mainPath, '.git'), branch: 'main' },
+            { path: worktreePath, kind: 'worktree', gitDir: worktreeGitDir, branch: 'feature' }
+          ]);
+        })
+        .then(() => {
+          rimraf.sync(classifyBasePath);
+          done();
+        })
+        .catch(error => {
+          rimraf.sync(classifyBasePath);
+          done(error);
+        });
+    });
+
+    it('can find all repositories when the frontier is over its memory limit', function(done) {
+      const { repositoryPaths } = this;
+
+      // A limit this small keeps every traversal thread searching depth-first.
+      findGitRepos(basePath, () => {}, { concurrency: 2, frontierMemoryLimitMB: 0.001 })
+        .then(paths => {
+          assert.equal(paths.length, Object.keys(repositoryPaths).length, 'Found a different number of repositories');
+          paths.forEach(repositoryPath => {
+            assert.equal(repositoryPaths[repositoryPath], false, 'Found a repo that should not exist or a duplicate');
+            repositoryPaths[repositoryPath] = true;
+          });
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('can stop a prioritized search once its budget is spent', function(done) {
+      const { repositoryPaths } = this;
+
+      findGitRepos(basePath, () => {}, { prioritize: true, maxDirectories: 10, stats: true })
+        .then(({ repositories, stats }) => {
+          assert.ok(stats.directoriesLeft > 0, 'Did not count the directories left');
+          assert.ok(stats.directoriesOpened <= 10, 'Opened more directories than the budget');
+          repositories.forEach(repositoryPath => {
+            assert.equal(repositoryPaths[repositoryPath], false, 'Found a repo that should not exist or a duplicate');
+            repositoryPaths[repositoryPath] = true;
+          });
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('ranks directories queued over the memory limit normally once back under it', function(done) {
+      // The long name alone puts the frontier over its limit, so the directory below it is queued
+      // depth-first. Once it is searched the frontier is back under half the limit, and the shallower
+      // repository comes first again.
+      const longName = `a${'x'.repeat(200000)}`;
+      const lines = ['0\td\t.', `1\td\t${longName}`, '2\td\tdeep', '3\td\t.git', '1\td\tshallow', '2\td\t.git'];
+      const snapshotPath = path.resolve('.', 'pressure.snapshot');
+      fs.writeFileSync(snapshotPath, `${lines.join('\n')}\n`);
+
+      findGitRepos.loadSnapshot(snapshotPath)
+        .then(snapshot => findGitRepos('.', () => {}, {
+          fileSystem: snapshot,
+          prioritize: true,
+          concurrency: 1,
+          frontierMemoryLimitMB: 0.1
+        }))
+        .then(paths => {
+          assert.deepEqual(paths, [
+            ['.', 'shallow', '.git'].join(path.sep),
+            ['.', longName, 'deep', '.git'].join(path.sep)
+          ], 'Kept ranking the directory queued over the limit first');
+        })
+        .then(() => fs.unlinkSync(snapshotPath))
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('can find all repositories in the background at a limited rate', function(done) {
+      const { repositoryPaths } = this;
+
+      const background = { directoriesPerSecond: 100000, cacheHints: true };
+      findGitRepos(basePath, () => {}, { background, concurrency: 2, stats: true })
+        .then(({ repositories, stats }) => {
+          assert.equal(repositories.length, Object.keys(repositoryPaths).length, 'Found a different number of repositories');
+          repositories.forEach(repositoryPath => {
+            assert.equal(repositoryPaths[repositoryPath], false, 'Found a repo that should not exist or a duplicate');
+            repositoryPaths[repositoryPath] = true;
+          });
+          assert.ok(stats.background.directoriesPerSecond > 0, 'Did not report the directory rate');
+          assert.ok(stats.background.throttledMS >= 0, 'Did not report the time spent throttled');
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('can find all repositories in a snapshot held in memory', function(done) {
+      const { repositoryPaths } = this;
+
+      // The tree in the snapshot format, depth-first, with the type of a few entries left unknown.
+      const lines = ['0\td\t.'];
+      const walk = (directoryPath, depth) => {
+        fs.readdirSync(directoryPath, { withFileTypes: true }).forEach((entry, i) => {
+          const type = entry.isDirectory() ? 'd' : 'f';
+          lines.push(`${depth}\t${i % 5 === 0 ? type.toUpperCase() : type}\t${entry.name}`);
+          if (entry.isDirectory()) {
+            walk(path.join(directoryPath, entry.name), depth + 1);
+          }
+        });
+      };
+      walk(basePath, 1);
+      const snapshotPath = path.resolve('.', 'fs.snapshot');
+      fs.writeFileSync(snapshotPath, `${lines.join('\n')}\n`);
+
+      // Paths in the snapshot are relative to its root.
+      const snapshotPaths = {};
+      Object.keys(repositoryPaths).forEach(repositoryPath => {
+        snapshotPaths[['.', path.relative(basePath, repositoryPath)].join(path.sep)] = false;
+      });
+
+      findGitRepos.loadSnapshot(snapshotPath, { listLatencyUS: 10 })
+        .then(snapshot => {
+          assert.equal(snapshot.entries, lines.length, 'Loaded a different number of entries');
+          return findGitRepos('.', () => {}, { fileSystem: snapshot, concurrency: 2, stats: true });
+        })
+        .then(({ repositories, stats }) => {
+          repositories.forEach(repositoryPath => {
+            assert.equal(snapshotPaths[repositoryPath], false, 'Found a repo that should not exist or a duplicate');
+            snapshotPaths[repositoryPath] = true;
+          });
+          Object.keys(snapshotPaths).forEach(repositoryPath => {
+            assert.equal(snapshotPaths[repositoryPath], true, 'Did not find a path in the snapshot');
+          });
+          assert.ok(stats.statFallbacks > 0, 'Did not look up the entries of unknown type');
+        })
+        .then(() => fs.unlinkSync(snapshotPath))
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('can stream repositories in batches', function(done) {
+      const { repositoryPaths } = this;
+
+      const readAll = async () => {
+        let numBatches = 0;
+        // A small high water mark pauses the search every few repositories until the loop catches up.
+        for await (const batch of findGitRepos.stream(basePath, { highWaterMark: 4, concurrency: 2 })) {
+          numBatches++;
+          assert.ok(batch.length > 0, 'Received an empty batch');
+          batch.forEach(repositoryPath => {
+            assert.equal(repositoryPaths[repositoryPath], false, 'Found a repo that should not exist or a duplicate');
+            repositoryPaths[repositoryPath] = true;
+          });
+        }
+        return numBatches;
+      };
+
+      readAll()
+        .then(numBatches => {
+          assert.ok(numBatches > 1, 'Received every repository in a single batch');
+          Object.keys(repositoryPaths).forEach(repositoryPath => {
+            assert.equal(repositoryPaths[repositoryPath], true, 'Did not find a path in the file system');
+          });
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('only calls the progress callback with repositories not reported yet', function(done) {
+      const { repositoryPaths } = this;
+      const reported = [];
+      let numEmptyBatches = 0;
+
+      findGitRepos(basePath, paths => {
+        numEmptyBatches += paths.length === 0 ? 1 : 0;
+        reported.push(...paths);
+      }, { throttleTimeoutMS: 0, concurrency: 4, stats: true })
+        .then(({ repositories, stats }) => {
+          assert.equal(numEmptyBatches, 0, 'Called the progress callback without a new repository');
+          assert.equal(new Set(reported).size, reported.length, 'Reported a repository twice');
+          reported.forEach(repositoryPath => {
+            assert.ok(repositoryPaths[repositoryPath] !== undefined, 'Found a repo that should not exist');
+          });
+          assert.equal(repositories.length, Object.keys(repositoryPaths).length, 'Found a different number of repositories');
+          assert.ok(stats.progressCallbacks <= reported.length, 'Called the progress callback more often than needed');
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('reports every repository to the progress callback before resolving', function(done) {
+      const { repositoryPaths } = this;
+      const expectedPaths = Object.keys(repositoryPaths).sort();
+      const reported = [];
+      const sharedReported = [];
+
+      // With a long throttle the last repositories are still waiting when the search ends.
+      Promise.all([
+        findGitRepos(basePath, paths => reported.push(...paths), { throttleTimeoutMS: 60000, stats: true }),
+        findGitRepos(basePath, paths => sharedReported.push(...paths), { throttleTimeoutMS: 60000 })
+      ])
+        .then(([{ repositories }, sharedRepositories]) => {
+          assert.deepEqual(repositories.sort(), expectedPaths, 'Did not find every repository');
+          assert.deepEqual(reported.sort(), expectedPaths, 'Did not report every repository found');
+          assert.deepEqual(sharedRepositories.sort(), expectedPaths, 'Did not find every repository in a shared search');
+          assert.deepEqual(sharedReported.sort(), expectedPaths, 'Did not report every repository found in a shared search');
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('only calls the progress callbacks of a shared search with repositories not reported yet', function(done) {
+      const { repositoryPaths } = this;
+      const nestedPath = fs.readdirSync(basePath, { withFileTypes: true })
+        .filter(entry => entry.isDirectory())
+        .map(entry => path.join(basePath, entry.name))[0];
+      const reported = [];
+      const nestedReported = [];
+      let numEmptyBatches = 0;
+
+      Promise.all([
+        findGitRepos(basePath, paths => {
+          numEmptyBatches += paths.length === 0 ? 1 : 0;
+          reported.push(...paths);
+        }, { throttleTimeoutMS: 0, concurrency: 4 }),
+        findGitRepos(nestedPath, paths => {
+          numEmptyBatches += paths.length === 0 ? 1 : 0;
+          nestedReported.push(...paths);
+        }, { throttleTimeoutMS: 0, coalesce: true })
+      ])
+        .then(([repositories, nestedRepositories]) => {
+          assert.equal(numEmptyBatches, 0, 'Called a progress callback without a new repository');
+          assert.equal(new Set(reported).size, reported.length, 'Reported a repository twice');
+          assert.equal(new Set(nestedReported).size, nestedReported.length, 'Reported a nested repository twice');
+          assert.deepEqual(reported.sort(), Object.keys(repositoryPaths).sort(), 'Did not report every repository');
+          assert.deepEqual(repositories.sort(), reported, 'Did not find every reported repository');
+          assert.deepEqual(nestedRepositories.sort(), nestedReported.sort(), 'Did not find every reported nested repository');
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('can report statistics of a search', function(done) {
+      const { repositoryPaths } = this;
+      let numProgressCallbacks = 0;
+
+      findGitRepos(basePath, () => { numProgressCallbacks++; }, { stats: true, latencySampleInterval: 1, concurrency: 2 })
+        .then(({ repositories, stats }) => {
+          const numRepositories = Object.keys(repositoryPaths).length;
+          assert.equal(repositories.length, numRepositories, 'Found a different number of repositories');
+          assert.equal(stats.repositoriesFound, numRepositories, 'Counted a different number of repositories');
+          assert.equal(stats.progressCallbacks, numProgressCallbacks, 'Counted a different number of progress callbacks');
+          assert.ok(stats.directoriesOpened > numRepositories, 'Did not count opened directories');
+          assert.ok(stats.entriesRead >= stats.directoriesOpened, 'Did not count read entries');
+          assert.ok(stats.maxPendingDirectories > 0, 'Did not track pending directories');
+          assert.ok(stats.timeToFirstRepositoryMS >= 0, 'Did not time the first repository');
+          assert.ok(stats.phases.traversal.wallMS > 0, 'Did not time the traversal');
+          assert.equal(
+            stats.latency.histogram.reduce((sum, bucket) => sum + bucket.count, 0),
+            stats.latency.samples,
+            'Histogram does not add up to the number of samples'
+          );
+          assert.ok(stats.latency.slowestDirectories.length > 0, 'Did not report the slowest directories');
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    if (process.platform === 'linux') {
+      it('can find all repositories while tracking mounts', function(done) {
+        const { repositoryPaths } = this;
+        const mountLimit = { concurrency: 1, timeoutMS: 60000 };
+        const mountLimits = { ext4: mountLimit, xfs: mountLimit, btrfs: mountLimit, overlay: mountLimit, tmpfs: mountLimit };
+
+        findGitRepos(basePath, () => {}, { stats: true, concurrency: 4, oneFileSystem: true, skipPseudoFileSystems: true, mountLimits })
+          .then(({ repositories, stats }) => {
+            assert.deepEqual(repositories.sort(), Object.keys(repositoryPaths).sort(), 'Did not find every repository');
+            assert.equal(stats.mountsSkipped, 0, 'Skipped a mount');
+            assert.equal(stats.mountsTimedOut, 0, 'Timed out on a mount');
+          })
+          .then(() => done())
+          .catch(error => done(error));
+      });
+    }
+
+    it('will not search in excluded folders', function(done) {
+      const { repositoryPaths } = this;
+      const excludedPath = path.resolve(basePath, 'guaranteed_repo');
+      const isExcluded = repositoryPath => repositoryPath.indexOf(excludedPath + path.sep) === 0;
+
+      findGitRepos(basePath, () => {}, { exclude: ['guaranteed_*'], include: ['submodule'] })
+        .then(paths => {
+          paths.forEach(repositoryPath => {
+            assert.equal(isExcluded(repositoryPath), false, 'Found a repo in an excluded folder');
+            assert.equal(
+              repositoryPaths[repositoryPath],
+              Boolean(repositoryPaths[repositoryPath]),
+              'Found a repo that should not exist'
+            );
+            repositoryPaths[repositoryPath] = true;
+          });
+
+          Object.keys(repositoryPaths)
+            .filter(repositoryPath => !isExcluded(repositoryPath))
+            .forEach(repositoryPath => {
+              assert.equal(repositoryPaths[repositoryPath], true, 'Did not find a path in the file system');
+            });
+        })
+        .then(() => done())
+        .catch(error => done(error));
+    });
+
+    it('excludes only what is inside a folder for a trailing /**', function() {
+      const patternsBasePath = path.resolve('.', 'fs-patterns');
+      rimraf.sync(patternsBasePath);
+      ['kept/.git', 'kept_inside/inner/.git', 'pruned/inner/.git', 'whole/.git', 'other/.git']
+        .forEach(repositoryPath => fs.mkdirSync(path.resolve(patternsBasePath, repositoryPath), { recursive: true }));
+
+      return findGitRepos(patternsBasePath, () => {}, { exclude: ['kept/**', 'pruned/**', 'whole'] })
+        .then(paths => {
+          assert.deepEqual(paths.sort(), [
+            path.resolve(patternsBasePath, 'kept', '.git'),
+            path.resolve(patternsBasePath, 'kept_inside', 'inner', '.git'),
+            path.resolve(patternsBasePath, 'other', '.git')
+          ]);
+        })
+        .finally(() => rimraf.sync(patternsBasePath));
+    });
+
     it('will not follow symlinks', function(done) {
       const { repositoryPaths } = this;
       const linkPathA = path.resolve(basePath, 'folder_a');
@@ -225,6 +872,222 @@ describe('findGitRepos', function() {
       });
     }
 
+    if (process.platform !== 'win32') {
+      it('can reuse an index of a previous search', function(done) {
+        const indexBasePath = path.resolve('.', 'fs-index');
+        const indexPath = path.resolve('.', 'fs-index.idx');
+        const { repositoryPaths } = createTree(indexBasePath, 4, 5);
+        const newRepositoryPath = path.resolve(indexBasePath, 'new_repo', '.git');
+        const expectedPaths = Object.keys(repositoryPaths).sort();
+
+        const cleanUp = () => {
+          rimraf.sync(indexBasePath);
+          rimraf.sync(indexPath);
+        };
+
+        rimraf.sync(indexPath);
+        findGitRepos(indexBasePath, () => {}, { indexPath })
+          .then(paths => {
+            assert.deepEqual(paths.sort(), expectedPaths, 'First search did not find every repository');
+            assert.equal(fs.existsSync(indexPath), true, 'Did not write the index');
+            return findGitRepos(indexBasePath, () => {}, { indexPath });
+          })
+          .then(paths => {
+            assert.deepEqual(paths.sort(), expectedPaths, 'Search using the index did not find every repository');
+            fs.mkdirSync(newRepositoryPath, { recursive: true });
+            return findGitRepos(indexBasePath, () => {}, { indexPath });
+          })
+          .then(paths => {
+            assert.deepEqual(paths.sort(), expectedPaths.concat(newRepositoryPath).sort(), 'Did not find the new repository');
+          })
+          .then(() => {
+            cleanUp();
+            done();
+          })
+          .catch(error => {
+            cleanUp();
+            done(error);
+          });
+      });
+    }
+
+    if (process.platform !== 'win32') {
+      it('ignores an index whose records point outside of it', function(done) {
+        const indexBasePath = path.resolve('.', 'fs-index-corrupt');
+        const indexPath = path.resolve('.', 'fs-index-corrupt.idx');
+        const { repositoryPaths } = createTree(indexBasePath, 3, 4);
+        const expectedPaths = Object.keys(repositoryPaths).sort();
+        // See ScanIndexHeader and ScanIndexRecord.
+        const headerSize = 32;
+        const recordSize = 48;
+        const namesOffsetInRecord = 24;
+
+        const cleanUp = () => {
+          rimraf.sync(indexBasePath);
+          rimraf.sync(indexPath);
+        };
+
+        rimraf.sync(indexPath);
+        backdateTree(indexBasePath);
+        findGitRepos(indexBasePath, () => {}, { indexPath })
+          .then(() => {
+            const index = fs.readFileSync(indexPath);
+            const recordCount = Number(index.readBigUInt64LE(16));
+            assert.ok(recordCount > 0, 'Did not index the directories');
+            for (let i = 0; i < recordCount; ++i) {
+              index.writeBigUInt64LE(0xffffffffn, headerSize + i * recordSize + namesOffsetInRecord);
+            }
+            fs.writeFileSync(indexPath, index);
+            return findGitRepos(indexBasePath, () => {}, { indexPath, stats: true });
+          })
+          .then(({ repositories, stats }) => {
+            assert.deepEqual(repositories.sort(), expectedPaths, 'Search with a corrupted index did not find every repository');
+            assert.equal(stats.directoriesFromIndex, 0, 'Trusted a corrupted index');
+          })
+          .then(() => {
+            cleanUp();
+            done();
+          })
+          .catch(error => {
+            cleanUp();
+            done(error);
+          });
+      });
+    }
+
+    if (process.platform === 'linux') {
+      it('can reuse an index of a tree holding a directory twice', function(done) {
+        const indexBasePath = path.resolve('.', 'fs-index-bind');
+        const indexPath = path.resolve('.', 'fs-index-bind.idx');
+        createTree(indexBasePath, 3, 4);
+        const bindPath = path.resolve(indexBasePath, 'bind');
+        fs.mkdirSync(bindPath);
+        try {
+          execFileSync('mount', ['--bind', path.resolve(indexBasePath, '0'), bindPath], { stdio: 'ignore' });
+        } catch (error) {
+          rimraf.sync(indexBasePath);
+          this.skip();
+          return;
+        }
+
+        const cleanUp = () => {
+          execFileSync('umount', [bindPath]);
+          rimraf.sync(indexBasePath);
+          rimraf.sync(indexPath);
+        };
+
+        let expectedPaths;
+        rimraf.sync(indexPath);
+        backdateTree(indexBasePath);
+        findGitRepos(indexBasePath, () => {}, { indexPath })
+          .then(paths => {
+            expectedPaths = paths.sort();
+            assert.ok(expectedPaths.some(repositoryPath => repositoryPath.startsWith(bindPath + path.sep)), 'Did not search the bind mount');
+            return findGitRepos(indexBasePath, () => {}, { indexPath, stats: true });
+          })
+          .then(({ repositories, stats }) => {
+            assert.deepEqual(repositories.sort(), expectedPaths, 'Search using the index did not find every repository');
+            assert.ok(stats.directoriesFromIndex > 0, 'Did not use the index');
+          })
+          .then(() => {
+            cleanUp();
+            done();
+          })
+          .catch(error => {
+            cleanUp();
+            done(error);
+          });
+      });
+    }
+
+    if (process.platform === 'linux') {
+      it('can watch for repositories being added and removed', function(done) {
+        const watchBasePath = path.resolve('.', 'fs-watch');
+        const { repositoryPaths } = createTree(watchBasePath, 3, 4);
+        const newRepositoryPath = path.resolve(watchBasePath, 'new_repo', '.git');
+        const watchedPaths = {};
+        let watcher;
+
+        const finish = error => {
+          watcher.close();
+          rimraf.sync(watchBasePath);
+          done(error);
+        };
+
+        const steps = [
+          () => Object.keys(repositoryPaths).every(repositoryPath => watchedPaths[repositoryPath]),
+          () => watchedPaths[newRepositoryPath],
+          () => !watchedPaths[newRepositoryPath]
+        ];
+        const actions = [
+          () => fs.mkdirSync(newRepositoryPath, { recursive: true }),
+          () => rimraf.sync(path.dirname(newRepositoryPath)),
+          () => finish()
+        ];
+
+        watcher = findGitRepos.watch(watchBasePath, events => {
+          try {
+            events.forEach(({ type, path: repositoryPath }) => {
+              if (type === 'added') {
+                assert.equal(Boolean(watchedPaths[repositoryPath]), false, 'Duplicate added event received');
+                watchedPaths[repositoryPath] = true;
+              } else {
+                assert.equal(watchedPaths[repositoryPath], true, 'Removed event for an unknown repository');
+                delete watchedPaths[repositoryPath];
+              }
+            });
+
+            while (steps.length && steps[0]()) {
+              steps.shift();
+              actions.shift()();
+            }
+          } catch (error) {
+            finish(error);
+          }
+        });
+      });
+    }
+
+    if (process.platform === 'linux') {
+      it('keeps the exclude patterns when watching', function(done) {
+        const watchBasePath = path.resolve('.', 'fs-watch-exclude');
+        createTree(watchBasePath, 2, 2);
+        const excludedPaths = [
+          path.resolve(watchBasePath, 'ignored', '.git'),
+          path.resolve(watchBasePath, 'skipped', 'inner', '.git')
+        ];
+        const keptPath = path.resolve(watchBasePath, 'skipped', 'kept', '.git');
+        let initialSearchDone = false;
+        let watcher;
+
+        const finish = error => {
+          watcher.close();
+          rimraf.sync(watchBasePath);
+          done(error);
+        };
+
+        watcher = findGitRepos.watch(watchBasePath, events => {
+          try {
+            events.forEach(({ type, path: repositoryPath }) => {
+              assert.equal(type, 'added', 'Removed event received');
+              assert.ok(!excludedPaths.includes(repositoryPath), `Reported excluded ${repositoryPath}`);
+              if (repositoryPath === keptPath) {
+                finish();
+              }
+            });
+
+            if (!initialSearchDone) {
+              initialSearchDone = true;
+              excludedPaths.forEach(excludedPath => fs.mkdirSync(excludedPath, { recursive: true }));
+              fs.mkdirSync(keptPath, { recursive: true });
+            }
+          } catch (error) {
+            finish(error);
+          }
+        }, { exclude: ['ignored', 'skipped/inner'], concurrency: 2 });
+      });
+    }
+
     it('can find repositories at a specified subfolders depth in a file system', function(done) {
       const maxSubfolderDeep = 2;
       const basePathSubfolderDeep = basePath.split(path.sep).length;
@@ -0,0 +1,12 @@
+const fs = require('fs');
+const path = require('path');
+
+// Directories modified within the last second are never indexed, so index specs move the tree back in time.
+const backdateTree = directoryPath => {
+  fs.readdirSync(directoryPath, { withFileTypes: true })
+    .filter(entry => entry.isDirectory())
+    .forEach(entry => backdateTree(path.resolve(directoryPath, entry.name)));
+  fs.utimesSync(directoryPath, 1000000000, 1000000000);
+};
+
+module.exports = backdateTree;